@@ -0,0 +1,465 @@
+#include "bank.hpp"
+#include "ltf/parser.hpp"
+#include "ltf/taskindex.hpp"
+#include "trace.hpp"
+
+#include <QtCore/QFile>
+#include <QtCore/QBuffer>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QFileInfo>
+#include <QtGui/QImageReader>
+#include <QtCore/QCollator>
+#include <QtCore/QObject>
+#include <QtCore/QRegularExpression>
+#include <QtCore/QThread>
+
+#include <algorithm>
+#include <thread>
+
+namespace ipp3 {
+
+Bank::Bank(const ipp3::ltf::Document& doc, const QDir& imageDir, Images images,
+		   const QSize& imageSize) :
+	images_(images),
+	imageSize_(imageSize),
+	imageDir_(imageDir)
+{
+	build(doc);
+}
+
+Bank::Bank(const ipp3::ltf::Document& doc, QSharedPointer<const Bundle> bundle, Images images,
+		   const QSize& imageSize) :
+	images_(images),
+	imageSize_(imageSize),
+	bundle_(bundle)
+{
+	build(doc);
+}
+
+void Bank::build(const ipp3::ltf::Document& doc)
+{
+	TraceSpan span("Bank", "load");
+	span.setArg("tasks", doc.tasks.size());
+
+	// Phrases and gaps are numbered in file order, the phrases of a task
+	// being its gaps followed by its extras. So the ranges of every task
+	// are known up front and tasks can be built into their own slots.
+	int tasksCount = doc.tasks.size();
+	QVector<int> firstPhrase(tasksCount + 1, 0);
+	QVector<int> firstGap(tasksCount + 1, 0);
+	for (int i = 0; i < tasksCount; ++i) {
+		const ltf::Task& task = doc.tasks[i];
+		int gaps = std::count_if(task.content.begin(), task.content.end(),
+								 [] (const Either<ltf::Text, ltf::Gap>& elem) { return elem.isRight(); });
+		firstGap[i + 1] = firstGap[i] + gaps;
+		firstPhrase[i + 1] = firstPhrase[i] + gaps + task.extra.size();
+	}
+	tasks_.resize(tasksCount);
+	phrases_.resize(firstPhrase[tasksCount]);
+	gaps_.resize(firstGap[tasksCount]);
+
+	// Workers write through raw pointers, so that no QVector is detached
+	// (or checked for it) concurrently.
+	Slots slots {tasks_.data(), phrases_.data(), gaps_.data()};
+	int threads = qBound(1, QThread::idealThreadCount(), qMax(1, tasksCount / minTasksPerThread));
+	std::vector<std::thread> workers;
+	for (int i = 0; i < threads; ++i) {
+		int begin = qint64(tasksCount) * i / threads;
+		int end = qint64(tasksCount) * (i + 1) / threads;
+		auto work = [=, &doc, &firstPhrase, &firstGap] () {
+			buildTasks(doc, begin, end, firstPhrase, firstGap, slots);
+		};
+		if (i == threads - 1) {
+			work();
+		} else {
+			workers.emplace_back(work);
+		}
+	}
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+
+	contentHash_ = hashContent(doc);
+
+	// Images share the caches below, they are loaded on this thread.
+	if (images_ == Images::Load) {
+		int gapIndex = 0;
+		for (const ltf::Task& task : doc.tasks) {
+			for (const Either<ltf::Text, ltf::Gap>& elem : task.content) {
+				if (elem.isRight()) {
+					loadGapImage(&gaps_[gapIndex++], elem.right().img.toString());
+				}
+			}
+		}
+	}
+
+	imagesByPath_.clear();
+	imagesByHash_.clear();
+	imagesByBlob_.clear();
+	missingBundleImages_.clear();
+}
+
+QSharedPointer<const Bank> Bank::load(const QString& fileName, Images images, QString* error,
+									   const QSize& imageSize)
+{
+	QSharedPointer<const Bundle> bundle;
+	QFile file(fileName);
+	QByteArray text;
+	if (Bundle::isBundle(fileName)) {
+		bundle = Bundle::open(fileName, error);
+		if (!bundle)
+			return {};
+		text = bundle->document();
+	} else if (file.open(QFile::ReadOnly)) {
+		text = file.readAll();
+	} else {
+		*error = QObject::tr("Cannot open the file %1.").arg(fileName);
+		return {};
+	}
+
+	ltf::Parser parser;
+	parser.setPipelined(text.size() >= minPipelinedBytes && QThread::idealThreadCount() > 1);
+	ltf::Document doc;
+	try {
+		doc = parser.parse(text);
+	} catch (const ltf::ParserError& e) {
+		*error = QObject::tr("An error was encountered when reading the test file:\n%1").arg(e.message());
+		return {};
+	}
+
+	if (bundle)
+		return QSharedPointer<const Bank>(new Bank(doc, bundle, images, imageSize));
+	return QSharedPointer<const Bank>(new Bank(doc, QFileInfo(file).dir(), images, imageSize));
+}
+
+QSharedPointer<const Bank> Bank::loadTasks(const QString& fileName, const QVector<int>& tasks,
+										   Images images, QString* error, const QSize& imageSize)
+{
+	// Bundles carry the task index of their text.
+	QSharedPointer<const Bundle> bundle;
+	QFile file(fileName);
+	if (Bundle::isBundle(fileName)) {
+		bundle = Bundle::open(fileName, error);
+		if (!bundle)
+			return {};
+	} else if (!file.open(QFile::ReadOnly)) {
+		*error = QObject::tr("Cannot open the file %1.").arg(fileName);
+		return {};
+	}
+
+	ltf::Document doc;
+	try {
+		if (bundle) {
+			QByteArray text = bundle->document();
+			QBuffer buffer(&text);
+			buffer.open(QBuffer::ReadOnly);
+			doc = ltf::TaskIndex::fromEntries(bundle->taskIndex()).parse(&buffer, tasks);
+		} else {
+			doc = ltf::TaskIndex::forFile(fileName).parse(&file, tasks);
+		}
+	} catch (const ltf::ParserError& e) {
+		*error = QObject::tr("An error was encountered when reading the test file:\n%1").arg(e.message());
+		return {};
+	}
+
+	if (bundle)
+		return QSharedPointer<const Bank>(new Bank(doc, bundle, images, imageSize));
+	return QSharedPointer<const Bank>(new Bank(doc, QFileInfo(file).dir(), images, imageSize));
+}
+
+int Bank::tasksCount(const QString& fileName, QString* error)
+{
+	try {
+		if (Bundle::isBundle(fileName)) {
+			QSharedPointer<const Bundle> bundle = Bundle::open(fileName, error);
+			if (!bundle)
+				return -1;
+			return ltf::TaskIndex::fromEntries(bundle->taskIndex()).size();
+		}
+		return ltf::TaskIndex::forFile(fileName).size();
+	} catch (const ltf::ParserError& e) {
+		*error = QObject::tr("An error was encountered when reading the test file:\n%1").arg(e.message());
+		return -1;
+	}
+}
+
+const QVector<Bank::TaskData>& Bank::tasks() const
+{
+	return tasks_;
+}
+
+const QVector<Bank::PhraseData>& Bank::phrases() const
+{
+	return phrases_;
+}
+
+const QVector<Bank::GapData>& Bank::gaps() const
+{
+	return gaps_;
+}
+
+QStringList Bank::warnings() const
+{
+	return warnings_;
+}
+
+QByteArray Bank::contentHash() const
+{
+	return contentHash_;
+}
+
+QByteArray Bank::hashContent(const ltf::Document& doc)
+{
+	// Every string is prefixed by its kind and size, so that different
+	// contents cannot hash the same bytes. Images do not affect answers.
+	QCryptographicHash hash(QCryptographicHash::Sha1);
+	auto add = [&hash] (char kind, const ltf::Text& text) {
+		hash.addData(&kind, 1);
+		hash.addData(reinterpret_cast<const char*>(&text.size), sizeof(text.size));
+		hash.addData(reinterpret_cast<const char*>(text.data), text.size * int(sizeof(QChar)));
+	};
+
+	for (const ltf::Task& task : doc.tasks) {
+		add('t', ltf::Text {nullptr, 0});
+		for (const Either<ltf::Text, ltf::Gap>& elem : task.content) {
+			if (elem.isRight()) {
+				add('g', elem.right().content);
+			} else {
+				add('x', elem.left());
+			}
+		}
+		for (const ltf::Text& extra : task.extra) {
+			add('e', extra);
+		}
+	}
+	return hash.result();
+}
+
+void Bank::memoryReport(MemoryReport* report) const
+{
+	report->addVector(MemoryReport::Indices, tasks_);
+	report->addVector(MemoryReport::Indices, phrases_);
+	report->addVector(MemoryReport::Indices, gaps_);
+
+	for (const TaskData& td : tasks_) {
+		report->addVector(MemoryReport::Indices, td.gapIndices);
+		report->addVector(MemoryReport::Indices, td.sortedChoices);
+		report->addVector(MemoryReport::Indices, td.prefixIndex);
+		report->addVector(MemoryReport::TextRuns, td.text);
+		for (const Either<QString, int>& elem : td.text) {
+			if (elem.isLeft()) {
+				report->addString(MemoryReport::WordStrings, elem.left());
+			}
+		}
+	}
+
+	for (const PhraseData& pd : phrases_) {
+		report->addStringList(MemoryReport::PhraseLists, pd.words);
+		report->addString(MemoryReport::WordStrings, pd.joinedLower);
+	}
+
+	for (const GapData& gd : gaps_) {
+		report->addStringList(MemoryReport::PhraseLists, gd.answer);
+		report->addImage(MemoryReport::Images, gd.image);
+	}
+}
+
+void Bank::buildTasks(const ltf::Document& doc, int begin, int end, const QVector<int>& firstPhrase,
+					  const QVector<int>& firstGap, const Slots& slots)
+{
+	IPP3_TRACE("Bank::buildTasks", "load");
+
+	// QCollator is not thread-safe, every worker has its own.
+	QCollator collator;
+	for (int i = begin; i < end; ++i) {
+		buildTask(i, doc.tasks[i], firstPhrase[i], firstGap[i], slots, collator);
+	}
+}
+
+void Bank::buildTask(int taskIndex, const ltf::Task& task, int phraseIndex, int gapIndex,
+					 const Slots& slots, const QCollator& collator)
+{
+	TaskData& td = slots.tasks[taskIndex];
+
+	for (const Either<ltf::Text, ltf::Gap>& elem : task.content) {
+		if (elem.isLeft()) {
+			for (const QString& word : toWords(elem.left())) {
+				td.text.push_back(word);
+			}
+		} else {
+			QStringList words = toWords(elem.right().content);
+			td.sortedChoices.push_back(phraseIndex);
+			setPhrase(&slots.phrases[phraseIndex++], taskIndex, words);
+
+			GapData& gd = slots.gaps[gapIndex];
+			gd.answer = words;
+			gd.taskIndex = taskIndex;
+			td.gapIndices.push_back(gapIndex);
+			td.text.push_back(gapIndex);
+			gapIndex++;
+		}
+	}
+
+	for (const ltf::Text& extra : task.extra) {
+		td.sortedChoices.push_back(phraseIndex);
+		setPhrase(&slots.phrases[phraseIndex++], taskIndex, toWords(extra));
+	}
+
+	sortChoices(&td, slots.phrases, collator);
+	buildPrefixIndex(&td, slots.phrases);
+}
+
+void Bank::setPhrase(PhraseData* pd, int taskIndex, const QStringList& words)
+{
+	pd->words = words;
+	pd->joinedLower = words.join(' ').toLower();
+	pd->taskIndex = taskIndex;
+	pd->sortedPosition = -1;
+}
+
+void Bank::sortChoices(TaskData* td, PhraseData* phrases, const QCollator& collator)
+{
+	// Sort phrases in the collation order of the current locale. The keys
+	// are computed once per phrase, so comparisons are cheap.
+	int first = td->sortedChoices.isEmpty() ? 0 : td->sortedChoices.first();
+	std::vector<QCollatorSortKey> keys;
+	keys.reserve(td->sortedChoices.size());
+	for (int i : td->sortedChoices) {
+		keys.push_back(collator.sortKey(phrases[i].joinedLower));
+	}
+
+	// The phrases of a task are numbered consecutively.
+	qSort(td->sortedChoices.begin(), td->sortedChoices.end(), [&] (int i, int j) {
+		int cmp = keys[i - first].compare(keys[j - first]);
+		if (cmp != 0)
+			return cmp < 0;
+		return i < j;
+	});
+
+	for (int i = 0; i < td->sortedChoices.size(); ++i) {
+		phrases[td->sortedChoices[i]].sortedPosition = i;
+	}
+}
+
+void Bank::buildPrefixIndex(TaskData* td, const PhraseData* phrases)
+{
+	// The lookup in Model::Task::choicesWithPrefix() relies on plain
+	// QString ordering, so this is not shared with the collation order.
+	td->prefixIndex = td->sortedChoices;
+	qSort(td->prefixIndex.begin(), td->prefixIndex.end(), [=] (int i, int j) {
+		return phrases[i].joinedLower < phrases[j].joinedLower;
+	});
+}
+
+void Bank::loadGapImage(GapData* gd, const QString& img)
+{
+	if (img.isEmpty())
+		return;
+
+	if (bundle_) {
+		gd->image = loadBundleImage(img);
+	} else {
+		gd->image = loadImage(QFileInfo(imageDir_, img).absoluteFilePath());
+	}
+}
+
+QImage Bank::loadImage(const QString& path)
+{
+	// Different spellings of a path resolve to the same canonical path,
+	// copies of a file under other names have the same content hash.
+	// A missing file has no canonical path, it is remembered by its
+	// absolute path so that it is reported once.
+	QFileInfo info(path);
+	QString canonicalPath = info.canonicalFilePath();
+	if (canonicalPath.isEmpty()) {
+		canonicalPath = info.absoluteFilePath();
+	}
+	auto byPath = imagesByPath_.constFind(canonicalPath);
+	if (byPath != imagesByPath_.constEnd()) {
+		return byPath.value();
+	}
+
+	IPP3_TRACE("Bank::loadImage", "load");
+	QFile file(path);
+	if (!file.open(QFile::ReadOnly)) {
+		warnings_.append(QObject::tr("Cannot load image \"%1\".").arg(path));
+		imagesByPath_.insert(canonicalPath, QImage());
+		return QImage();
+	}
+
+	QByteArray data = file.readAll();
+	QByteArray hash = QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+	auto byHash = imagesByHash_.constFind(hash);
+	if (byHash != imagesByHash_.constEnd()) {
+		imagesByPath_.insert(canonicalPath, byHash.value());
+		return byHash.value();
+	}
+
+	// Failures are remembered too, so they are reported once.
+	QImage image = decodeImage(&data, path);
+	imagesByHash_.insert(hash, image);
+	imagesByPath_.insert(canonicalPath, image);
+	return image;
+}
+
+QImage Bank::loadBundleImage(const QString& name)
+{
+	// The bundle stores identical images once, so blobs need no hashing.
+	Bundle::Image entry = bundle_->image(name);
+	if (entry.data == -1) {
+		// Not in the bundle, reported once per name.
+		if (!missingBundleImages_.contains(name)) {
+			missingBundleImages_.insert(name);
+			warnings_.append(QObject::tr("Cannot load image \"%1\".").arg(name));
+		}
+		return QImage();
+	}
+
+	QSize thumbnailSize = bundle_->thumbnailSize();
+	int blob = entry.data;
+	if (!imageSize_.isEmpty() && imageSize_.width() <= thumbnailSize.width()
+		&& imageSize_.height() <= thumbnailSize.height()) {
+		blob = entry.thumbnail;
+	}
+
+	auto byBlob = imagesByBlob_.constFind(blob);
+	if (byBlob != imagesByBlob_.constEnd())
+		return byBlob.value();
+
+	IPP3_TRACE("Bank::loadImage", "load");
+	QByteArray data = bundle_->blob(blob);
+	QImage image = decodeImage(&data, name);
+	imagesByBlob_.insert(blob, image);
+	return image;
+}
+
+QImage Bank::decodeImage(QByteArray* data, const QString& path)
+{
+	// The size is read from the header, only then the decoder knows how
+	// much it can scale down while decoding.
+	QBuffer buffer(data);
+	QImageReader reader(&buffer);
+	QSize size = reader.size();
+	if (!imageSize_.isEmpty() && size.isValid()
+		&& (size.width() > imageSize_.width() || size.height() > imageSize_.height())) {
+		reader.setScaledSize(size.scaled(imageSize_, Qt::KeepAspectRatio));
+	}
+
+	QImage image;
+	if (!reader.read(&image)) {
+		warnings_.append(QObject::tr("Cannot load image \"%1\".").arg(path));
+	}
+	return image;
+}
+
+QStringList Bank::toWords(const ltf::Text& text)
+{
+	// Matching with a const QRegularExpression is thread-safe, unlike QRegExp.
+	// The text is copied out of the document's arena first: trimmed() and
+	// split() may return the string they are given, which would still point
+	// into the arena after the document is gone.
+	static const QRegularExpression regexp("\\s+");
+	return text.toString().trimmed().split(regexp);
+}
+
+} // namespace ipp3
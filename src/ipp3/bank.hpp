@@ -0,0 +1,178 @@
+#ifndef IPP3_BANK_HPP
+#define IPP3_BANK_HPP
+
+#include <QtCore/QStringList>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+#include <QtCore/QDir>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QHash>
+#include <QtCore/QSet>
+#include <QtCore/QByteArray>
+#include <QtCore/QSize>
+#include <QtGui/QImage>
+
+#include "either.hpp"
+#include "bundle.hpp"
+#include "memoryreport.hpp"
+#include "ltf/document.hpp"
+
+class QCollator;
+
+namespace ipp3 {
+
+/**
+ * The static content of a test: texts, phrases, answers and images.
+ *
+ * @details
+ * A bank is built once from a LTF document and never changes afterwards,
+ * so a single instance can be shared (also between threads) by any number
+ * of models, each holding only its own answers.
+ */
+class Bank
+{
+public:
+	struct TaskData {
+		QVector<int> gapIndices;
+		// Phrases in the initial choice box order (locale collation).
+		QVector<int> sortedChoices;
+		// Phrases sorted by joinedLower.
+		QVector<int> prefixIndex;
+		QVector<Either<QString, int>> text;
+	};
+
+	struct PhraseData {
+		QStringList words;
+		QString joinedLower;
+		int taskIndex;
+		// Position in the task's sortedChoices.
+		int sortedPosition;
+	};
+
+	struct GapData {
+		// A null image encodes that the gap has no image. The image is
+		// decoded at the bank's image size.
+		QImage image;
+		QStringList answer;
+		int taskIndex;
+	};
+
+	enum class Images
+	{
+		Load,
+		/**
+		 * Gaps get no images, for use without a display (grading).
+		 */
+		Skip
+	};
+
+	/**
+	 * Builds a bank from a LTF document.
+	 *
+	 * Image paths will be resolved relative to @a imageDir. Larger images
+	 * are decoded directly at a resolution fitting @a imageSize (keeping
+	 * the aspect ratio), which for JPEG skips most of the decoding work.
+	 * An empty @a imageSize keeps the full resolution.
+	 */
+	Bank(const ltf::Document& doc, const QDir& imageDir, Images images = Images::Load,
+		 const QSize& imageSize = QSize());
+
+	/**
+	 * Builds a bank from a LTF document with images read from @a bundle.
+	 * Thumbnails are used when they are large enough for @a imageSize.
+	 */
+	Bank(const ltf::Document& doc, QSharedPointer<const Bundle> bundle, Images images = Images::Load,
+		 const QSize& imageSize = QSize());
+
+	/**
+	 * Parses and builds a bank from a LTF file or a bundle. Images of a
+	 * LTF file are resolved relative to the file. Returns null and sets
+	 * @a error on failure.
+	 */
+	static QSharedPointer<const Bank> load(const QString& fileName, Images images, QString* error,
+										   const QSize& imageSize = QSize());
+
+	/**
+	 * Like load(), but builds the bank from the given tasks only (in the
+	 * given order). Tasks are read through the ltf::TaskIndex of the LTF
+	 * file or the one stored in the bundle, so the cost does not depend on
+	 * the size of the file.
+	 */
+	static QSharedPointer<const Bank> loadTasks(const QString& fileName, const QVector<int>& tasks,
+												Images images, QString* error,
+												const QSize& imageSize = QSize());
+
+	/**
+	 * The number of tasks in a test file, from its task index. Returns -1
+	 * and sets @a error on failure.
+	 */
+	static int tasksCount(const QString& fileName, QString* error);
+
+	const QVector<TaskData>& tasks() const;
+	const QVector<PhraseData>& phrases() const;
+	const QVector<GapData>& gaps() const;
+
+	/**
+	 * Problems that did not prevent building the bank (missing images).
+	 */
+	QStringList warnings() const;
+
+	/**
+	 * SHA-1 of the texts, gaps and extras of all tasks. Answers saved for
+	 * a bank apply only to a bank with the same hash.
+	 */
+	QByteArray contentHash() const;
+
+	/**
+	 * Adds the memory used by the bank to @a report.
+	 */
+	void memoryReport(MemoryReport* report) const;
+
+private:
+	// Below this many tasks per thread the build is not worth splitting.
+	static const int minTasksPerThread = 256;
+	// Test files at least this large are tokenized on a separate thread.
+	static const int minPipelinedBytes = 1 << 20;
+
+	struct Slots {
+		TaskData* tasks;
+		PhraseData* phrases;
+		GapData* gaps;
+	};
+
+	static QStringList toWords(const ltf::Text& text);
+	static QByteArray hashContent(const ltf::Document& doc);
+	void build(const ltf::Document& doc);
+	void buildTasks(const ltf::Document& doc, int begin, int end, const QVector<int>& firstPhrase,
+					const QVector<int>& firstGap, const Slots& slots);
+	void buildTask(int taskIndex, const ltf::Task& task, int phraseIndex, int gapIndex,
+				   const Slots& slots, const QCollator& collator);
+	static void setPhrase(PhraseData* pd, int taskIndex, const QStringList& words);
+	static void sortChoices(TaskData* td, PhraseData* phrases, const QCollator& collator);
+	static void buildPrefixIndex(TaskData* td, const PhraseData* phrases);
+	void loadGapImage(GapData* gd, const QString& img);
+	QImage loadImage(const QString& path);
+	QImage loadBundleImage(const QString& name);
+	QImage decodeImage(QByteArray* data, const QString& path);
+
+	Images images_;
+	QSize imageSize_;
+	QDir imageDir_;
+	QSharedPointer<const Bundle> bundle_;
+	QVector<TaskData> tasks_;
+	QVector<PhraseData> phrases_;
+	QVector<GapData> gaps_;
+	QStringList warnings_;
+	QByteArray contentHash_;
+
+	// Images decoded so far, only used while building. Gaps sharing an
+	// image share its (implicitly shared) pixel data.
+	QHash<QString, QImage> imagesByPath_;
+	QHash<QByteArray, QImage> imagesByHash_;
+	QHash<int, QImage> imagesByBlob_;
+	QSet<QString> missingBundleImages_;
+};
+
+} // namespace ipp3
+
+#endif // IPP3_BANK_HPP
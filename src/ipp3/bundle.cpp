@@ -0,0 +1,326 @@
+#include "bundle.hpp"
+#include "ltf/parser.hpp"
+#include "ltf/taskindex.hpp"
+#include "trace.hpp"
+
+#include <QtCore/QBuffer>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDir>
+#include <QtCore/QFileInfo>
+#include <QtCore/QHash>
+#include <QtCore/QMap>
+#include <QtCore/QObject>
+#include <QtCore/QSaveFile>
+#include <QtCore/QtEndian>
+#include <QtGui/QImageReader>
+#include <QtGui/QImageWriter>
+
+#include <cstring>
+
+namespace ipp3 {
+
+// Layout, all numbers little endian:
+//   header (32 bytes): magic, version, blob count, image count,
+//     thumbnail width, thumbnail height, size of the names, zero
+//   blobs: offset (64 bits), size (64 bits); blob 0 is the LTF text,
+//     blob 1 its task index entries
+//   images sorted by name: name offset, name size, data blob,
+//     thumbnail blob (32 bits each)
+//   names, UTF-8, offsets relative to the start of the names
+//   blob contents, each aligned to 8 bytes
+
+static const char magic[] = "LTFB";
+static const quint32 formatVersion = 2;
+static const int headerSize = 32;
+static const int blobEntrySize = 16;
+static const int imageEntrySize = 16;
+
+const char* const Bundle::suffix = "ltfb";
+
+static QByteArray imageName(const QString& path)
+{
+	return QDir::cleanPath(path).toUtf8();
+}
+
+static void appendU32(QByteArray* out, quint32 value)
+{
+	uchar bytes[4];
+	qToLittleEndian(value, bytes);
+	out->append(reinterpret_cast<const char*>(bytes), 4);
+}
+
+static void appendU64(QByteArray* out, quint64 value)
+{
+	uchar bytes[8];
+	qToLittleEndian(value, bytes);
+	out->append(reinterpret_cast<const char*>(bytes), 8);
+}
+
+/**
+ * Encodes a thumbnail, or returns an empty array if the image already fits.
+ */
+static QByteArray makeThumbnail(const QByteArray& data, const QSize& thumbnailSize)
+{
+	QByteArray copy = data;
+	QBuffer buffer(&copy);
+	QImageReader reader(&buffer);
+	QSize size = reader.size();
+	if (!size.isValid() || (size.width() <= thumbnailSize.width()
+							&& size.height() <= thumbnailSize.height()))
+		return {};
+
+	reader.setScaledSize(size.scaled(thumbnailSize, Qt::KeepAspectRatio));
+	QImage image;
+	if (!reader.read(&image))
+		return {};
+
+	QByteArray thumbnail;
+	QBuffer out(&thumbnail);
+	out.open(QBuffer::WriteOnly);
+	QImageWriter(&out, image.hasAlphaChannel() ? "png" : "jpg").write(image);
+	return thumbnail;
+}
+
+bool Bundle::isBundle(const QString& fileName)
+{
+	QFile file(fileName);
+	return file.open(QFile::ReadOnly) && file.read(4) == QByteArray(magic, 4);
+}
+
+bool Bundle::create(const QString& ltfFileName, const QString& bundleFileName,
+					const QSize& thumbnailSize, QString* error)
+{
+	QFile ltfFile(ltfFileName);
+	if (!ltfFile.open(QFile::ReadOnly)) {
+		*error = QObject::tr("Cannot open the file %1.").arg(ltfFileName);
+		return false;
+	}
+	QByteArray text = ltfFile.readAll();
+
+	ltf::Document doc;
+	QByteArray taskIndex;
+	try {
+		doc = ltf::Parser().parse(text);
+		taskIndex = ltf::TaskIndex::build(text).entriesData();
+	} catch (const ltf::ParserError& e) {
+		*error = e.message();
+		return false;
+	}
+
+	QList<QByteArray> blobs;
+	blobs.append(text);
+	blobs.append(taskIndex);
+
+	// Images keyed by name, so that they come out sorted.
+	QMap<QByteArray, Image> images;
+	QHash<QByteArray, Image> imagesByHash;
+	QDir imageDir = QFileInfo(ltfFile).dir();
+	for (const ltf::Task& task : doc.tasks) {
+		for (const Either<ltf::Text, ltf::Gap>& elem : task.content) {
+			if (elem.isLeft() || elem.right().img.isEmpty())
+				continue;
+
+			QString img = elem.right().img.toString();
+			QByteArray name = imageName(img);
+			if (images.contains(name))
+				continue;
+
+			QFile imageFile(imageDir.filePath(img));
+			if (!imageFile.open(QFile::ReadOnly)) {
+				*error = QObject::tr("Cannot load image \"%1\".").arg(imageFile.fileName());
+				return false;
+			}
+
+			QByteArray data = imageFile.readAll();
+			QByteArray hash = QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+			if (!imagesByHash.contains(hash)) {
+				Image image {blobs.size(), blobs.size()};
+				blobs.append(data);
+
+				if (!thumbnailSize.isEmpty()) {
+					QByteArray thumbnail = makeThumbnail(data, thumbnailSize);
+					if (!thumbnail.isEmpty()) {
+						image.thumbnail = blobs.size();
+						blobs.append(thumbnail);
+					}
+				}
+				imagesByHash.insert(hash, image);
+			}
+			images.insert(name, imagesByHash.value(hash));
+		}
+	}
+
+	QByteArray names;
+	QByteArray imageTable;
+	for (auto it = images.constBegin(); it != images.constEnd(); ++it) {
+		appendU32(&imageTable, names.size());
+		appendU32(&imageTable, it.key().size());
+		appendU32(&imageTable, it.value().data);
+		appendU32(&imageTable, it.value().thumbnail);
+		names.append(it.key());
+	}
+
+	QByteArray header(magic, 4);
+	appendU32(&header, formatVersion);
+	appendU32(&header, blobs.size());
+	appendU32(&header, images.size());
+	appendU32(&header, thumbnailSize.isEmpty() ? 0 : thumbnailSize.width());
+	appendU32(&header, thumbnailSize.isEmpty() ? 0 : thumbnailSize.height());
+	appendU32(&header, names.size());
+	appendU32(&header, 0);
+
+	auto align = [] (quint64 offset) { return (offset + 7) & ~quint64(7); };
+	quint64 offset = align(headerSize + blobs.size() * blobEntrySize + imageTable.size() + names.size());
+	QByteArray blobTable;
+	for (const QByteArray& blob : blobs) {
+		appendU64(&blobTable, offset);
+		appendU64(&blobTable, blob.size());
+		offset = align(offset + blob.size());
+	}
+
+	QSaveFile out(bundleFileName);
+	if (!out.open(QFile::WriteOnly)) {
+		*error = QObject::tr("Cannot write the file %1.").arg(bundleFileName);
+		return false;
+	}
+
+	QByteArray index = header + blobTable + imageTable + names;
+	out.write(index);
+	out.write(QByteArray(align(index.size()) - index.size(), '\0'));
+	for (const QByteArray& blob : blobs) {
+		out.write(blob);
+		out.write(QByteArray(align(blob.size()) - blob.size(), '\0'));
+	}
+
+	if (!out.commit()) {
+		*error = QObject::tr("Cannot write the file %1.").arg(bundleFileName);
+		return false;
+	}
+	return true;
+}
+
+QSharedPointer<const Bundle> Bundle::open(const QString& fileName, QString* error)
+{
+	IPP3_TRACE("Bundle::open", "load");
+	QSharedPointer<Bundle> bundle(new Bundle(fileName));
+	if (!bundle->map(error))
+		return {};
+	return bundle;
+}
+
+Bundle::Bundle(const QString& fileName) :
+	file(fileName),
+	data(nullptr),
+	size(0),
+	blobCount(0),
+	imageCount(0),
+	imagesOffset(0),
+	namesOffset(0)
+{
+}
+
+bool Bundle::map(QString* error)
+{
+	*error = QObject::tr("The file %1 is not a valid test bundle.").arg(file.fileName());
+	if (!file.open(QFile::ReadOnly)) {
+		*error = QObject::tr("Cannot open the file %1.").arg(file.fileName());
+		return false;
+	}
+
+	size = file.size();
+	data = file.map(0, size);
+	if (!data || size < headerSize || memcmp(data, magic, 4) != 0 || u32(4) != formatVersion)
+		return false;
+
+	// Everything an offset points to is checked here or on access, so a
+	// damaged file cannot make us read outside the mapping.
+	blobCount = u32(8);
+	imageCount = u32(12);
+	thumbnailSize_ = QSize(u32(16), u32(20));
+	qint64 namesSize = u32(24);
+	imagesOffset = headerSize + qint64(blobCount) * blobEntrySize;
+	namesOffset = imagesOffset + qint64(imageCount) * imageEntrySize;
+	if (blobCount < 2 || imageCount < 0 || namesOffset + namesSize > size)
+		return false;
+
+	for (int i = 0; i < blobCount; ++i) {
+		quint64 offset = u64(headerSize + i * blobEntrySize);
+		quint64 blobSize = u64(headerSize + i * blobEntrySize + 8);
+		if (offset > quint64(size) || blobSize > quint64(size) - offset)
+			return false;
+	}
+
+	for (int i = 0; i < imageCount; ++i) {
+		qint64 entry = imagesOffset + i * imageEntrySize;
+		if (u32(entry) + qint64(u32(entry + 4)) > namesSize
+			|| qint32(u32(entry + 8)) >= blobCount || qint32(u32(entry + 12)) >= blobCount)
+			return false;
+	}
+
+	error->clear();
+	return true;
+}
+
+QByteArray Bundle::document() const
+{
+	return blob(0);
+}
+
+QByteArray Bundle::taskIndex() const
+{
+	return blob(1);
+}
+
+Bundle::Image Bundle::image(const QString& name) const
+{
+	QByteArray key = imageName(name);
+	int lo = 0;
+	int hi = imageCount;
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (nameAt(mid) < key) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	if (lo == imageCount || nameAt(lo) != key)
+		return Image {-1, -1};
+
+	qint64 entry = imagesOffset + lo * imageEntrySize;
+	return Image {qint32(u32(entry + 8)), qint32(u32(entry + 12))};
+}
+
+QByteArray Bundle::blob(int index) const
+{
+	if (index < 0 || index >= blobCount)
+		return {};
+
+	qint64 entry = headerSize + index * blobEntrySize;
+	return QByteArray::fromRawData(reinterpret_cast<const char*>(data + u64(entry)), int(u64(entry + 8)));
+}
+
+QSize Bundle::thumbnailSize() const
+{
+	return thumbnailSize_;
+}
+
+quint32 Bundle::u32(qint64 offset) const
+{
+	return qFromLittleEndian<quint32>(data + offset);
+}
+
+quint64 Bundle::u64(qint64 offset) const
+{
+	return qFromLittleEndian<quint64>(data + offset);
+}
+
+QByteArray Bundle::nameAt(int image) const
+{
+	qint64 entry = imagesOffset + image * imageEntrySize;
+	const char* name = reinterpret_cast<const char*>(data + namesOffset + u32(entry));
+	return QByteArray::fromRawData(name, int(u32(entry + 4)));
+}
+
+} // namespace ipp3
@@ -0,0 +1,99 @@
+#ifndef IPP3_BUNDLE_HPP
+#define IPP3_BUNDLE_HPP
+
+#include <QtCore/QByteArray>
+#include <QtCore/QString>
+#include <QtCore/QFile>
+#include <QtCore/QSize>
+#include <QtCore/QSharedPointer>
+
+namespace ipp3 {
+
+/**
+ * A test packed into one file together with its images.
+ *
+ * @details
+ * The file holds a header, an index, the LTF text and the image files
+ * as they were (see "docs/bundle.txt"). It is memory mapped, so opening
+ * a bundle reads nothing but the header and images are read straight
+ * from the mapping by offset. Identical images are stored once.
+ * Optionally every image larger than a given size has a pre-scaled
+ * thumbnail, which is what the GUI decodes.
+ */
+class Bundle
+{
+public:
+	/**
+	 * Indices of the blobs holding an image and its thumbnail, -1 if
+	 * missing. Images without a thumbnail use data for both.
+	 */
+	struct Image {
+		int data;
+		int thumbnail;
+	};
+
+	static const char* const suffix;
+
+	/**
+	 * Tells whether a file starts with the bundle magic.
+	 */
+	static bool isBundle(const QString& fileName);
+
+	/**
+	 * Packs a LTF file and the images it references. Thumbnails are made
+	 * for images larger than @a thumbnailSize, unless it is empty.
+	 * Returns false and sets @a error on failure.
+	 */
+	static bool create(const QString& ltfFileName, const QString& bundleFileName,
+					   const QSize& thumbnailSize, QString* error);
+
+	/**
+	 * Maps a bundle. Returns null and sets @a error on failure.
+	 */
+	static QSharedPointer<const Bundle> open(const QString& fileName, QString* error);
+
+	Bundle(const Bundle&) = delete;
+	Bundle& operator=(const Bundle&) = delete;
+
+	/**
+	 * The LTF text as it was in the packed file. Points into the mapping.
+	 */
+	QByteArray document() const;
+
+	/**
+	 * The ltf::TaskIndex entries of the LTF text. Points into the mapping.
+	 */
+	QByteArray taskIndex() const;
+
+	/**
+	 * Looks up an image by its path as written in the LTF text.
+	 */
+	Image image(const QString& name) const;
+
+	/**
+	 * The contents of a blob. Points into the mapping.
+	 */
+	QByteArray blob(int index) const;
+
+	QSize thumbnailSize() const;
+
+private:
+	Bundle(const QString& fileName);
+	bool map(QString* error);
+	quint32 u32(qint64 offset) const;
+	quint64 u64(qint64 offset) const;
+	QByteArray nameAt(int image) const;
+
+	QFile file;
+	const uchar* data;
+	qint64 size;
+	int blobCount;
+	int imageCount;
+	QSize thumbnailSize_;
+	qint64 imagesOffset;
+	qint64 namesOffset;
+};
+
+} // namespace ipp3
+
+#endif // IPP3_BUNDLE_HPP
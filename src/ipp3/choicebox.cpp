@@ -0,0 +1,320 @@
+#include "choicebox.hpp"
+
+namespace ipp3 {
+
+ChoiceBox::ChoiceBox() :
+	root(-1),
+	seed(2463534242u)
+{
+}
+
+int ChoiceBox::size() const
+{
+	return sizeOf(root);
+}
+
+bool ChoiceBox::isEmpty() const
+{
+	return root == -1;
+}
+
+bool ChoiceBox::contains(int value) const
+{
+	int node = nodeOf.value(value, -1);
+	return node != -1 && nodes[node].isInBox;
+}
+
+int ChoiceBox::at(int position) const
+{
+	Q_ASSERT(position >= 0 && position < size());
+
+	int node = root;
+	for (;;) {
+		int leftSize = sizeOf(nodes[node].left);
+		if (position < leftSize) {
+			node = nodes[node].left;
+		} else if (position == leftSize) {
+			return nodes[node].value;
+		} else {
+			position -= leftSize + 1;
+			node = nodes[node].right;
+		}
+	}
+}
+
+int ChoiceBox::indexOf(int value) const
+{
+	if (!contains(value))
+		return -1;
+
+	int node = nodeOf.value(value);
+	int position = sizeOf(nodes[node].left);
+	while (nodes[node].parent != -1) {
+		int parent = nodes[node].parent;
+		if (nodes[parent].right == node) {
+			position += sizeOf(nodes[parent].left) + 1;
+		}
+		node = parent;
+	}
+	return position;
+}
+
+void ChoiceBox::insert(int position, int value)
+{
+	Q_ASSERT(position >= 0 && position <= size());
+	Q_ASSERT(!contains(value));
+
+	int node = nodeFor(value);
+	nodes[node].isInBox = true;
+
+	int left, right;
+	split(root, position, &left, &right);
+	root = merge(merge(left, node), right);
+	nodes[root].parent = -1;
+}
+
+void ChoiceBox::append(int value)
+{
+	insert(size(), value);
+}
+
+int ChoiceBox::remove(int value)
+{
+	Q_ASSERT(contains(value));
+
+	int position = indexOf(value);
+
+	int left, middle, right;
+	split(root, position, &left, &middle);
+	split(middle, 1, &middle, &right);
+	root = merge(left, right);
+	if (root != -1) {
+		nodes[root].parent = -1;
+	}
+
+	Node& node = nodes[middle];
+	node.left = node.right = node.parent = -1;
+	node.size = 1;
+	node.isInBox = false;
+
+	return position;
+}
+
+void ChoiceBox::assign(const QVector<int>& values)
+{
+	for (Node& node : nodes) {
+		node.isInBox = false;
+	}
+
+	// Build a cartesian tree on the priorities with a stack, keeping
+	// the right spine of the tree built so far.
+	QVector<int> spine;
+	for (int value : values) {
+		Q_ASSERT(!contains(value));
+		int node = nodeFor(value);
+		nodes[node].isInBox = true;
+
+		int last = -1;
+		while (!spine.isEmpty() && nodes[spine.last()].priority < nodes[node].priority) {
+			last = spine.takeLast();
+		}
+		nodes[node].left = last;
+		if (!spine.isEmpty()) {
+			nodes[spine.last()].right = node;
+		}
+		spine.push_back(node);
+	}
+
+	root = spine.isEmpty() ? -1 : spine.first();
+	if (root == -1)
+		return;
+
+	// Fix sizes and parent links bottom-up (reversed preorder).
+	QVector<int> order;
+	QVector<int> stack {root};
+	while (!stack.isEmpty()) {
+		int node = stack.takeLast();
+		order.push_back(node);
+		if (nodes[node].left != -1)
+			stack.push_back(nodes[node].left);
+		if (nodes[node].right != -1)
+			stack.push_back(nodes[node].right);
+	}
+	for (int i = order.size() - 1; i >= 0; --i) {
+		update(order[i]);
+	}
+	nodes[root].parent = -1;
+}
+
+QVector<int> ChoiceBox::toVector() const
+{
+	QVector<int> values;
+	values.reserve(size());
+
+	QVector<int> stack;
+	int node = root;
+	while (node != -1 || !stack.isEmpty()) {
+		while (node != -1) {
+			stack.push_back(node);
+			node = nodes[node].left;
+		}
+		node = stack.takeLast();
+		values.push_back(nodes[node].value);
+		node = nodes[node].right;
+	}
+	return values;
+}
+
+ChoiceBox::const_iterator ChoiceBox::begin() const
+{
+	int node = root;
+	while (node != -1 && nodes[node].left != -1) {
+		node = nodes[node].left;
+	}
+	return const_iterator(this, node);
+}
+
+ChoiceBox::const_iterator ChoiceBox::end() const
+{
+	return const_iterator(this, -1);
+}
+
+qint64 ChoiceBox::memoryUsage() const
+{
+	// The hash costs about a node (key, value, next, hash) per entry.
+	return qint64(nodes.capacity()) * sizeof(Node) + qint64(nodeOf.capacity()) * sizeof(void*)
+		+ qint64(nodeOf.size()) * 4 * sizeof(void*);
+}
+
+int ChoiceBox::nodeFor(int value)
+{
+	int node = nodeOf.value(value, -1);
+	if (node == -1) {
+		node = nodes.size();
+		Node n;
+		n.value = value;
+		n.priority = nextPriority();
+		nodes.push_back(n);
+		nodeOf.insert(value, node);
+	}
+
+	Node& n = nodes[node];
+	n.left = n.right = n.parent = -1;
+	n.size = 1;
+	n.isInBox = false;
+	return node;
+}
+
+int ChoiceBox::sizeOf(int node) const
+{
+	return node == -1 ? 0 : nodes[node].size;
+}
+
+void ChoiceBox::update(int node)
+{
+	Node& n = nodes[node];
+	n.size = 1 + sizeOf(n.left) + sizeOf(n.right);
+	if (n.left != -1)
+		nodes[n.left].parent = node;
+	if (n.right != -1)
+		nodes[n.right].parent = node;
+}
+
+void ChoiceBox::split(int node, int count, int* left, int* right)
+{
+	if (node == -1) {
+		*left = *right = -1;
+		return;
+	}
+
+	int leftSize = sizeOf(nodes[node].left);
+	if (count <= leftSize) {
+		int child;
+		split(nodes[node].left, count, left, &child);
+		nodes[node].left = child;
+		*right = node;
+	} else {
+		int child;
+		split(nodes[node].right, count - leftSize - 1, &child, right);
+		nodes[node].right = child;
+		*left = node;
+	}
+	update(node);
+}
+
+int ChoiceBox::merge(int left, int right)
+{
+	if (left == -1)
+		return right;
+	if (right == -1)
+		return left;
+
+	if (nodes[left].priority > nodes[right].priority) {
+		nodes[left].right = merge(nodes[left].right, right);
+		update(left);
+		return left;
+	} else {
+		nodes[right].left = merge(left, nodes[right].left);
+		update(right);
+		return right;
+	}
+}
+
+quint32 ChoiceBox::nextPriority()
+{
+	// xorshift32
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+// ChoiceBox::const_iterator
+
+ChoiceBox::const_iterator::const_iterator() :
+	box(nullptr), node(-1)
+{
+}
+
+ChoiceBox::const_iterator::const_iterator(const ChoiceBox* box, int node) :
+	box(box), node(node)
+{
+}
+
+int ChoiceBox::const_iterator::operator*() const
+{
+	return box->nodes[node].value;
+}
+
+ChoiceBox::const_iterator& ChoiceBox::const_iterator::operator++()
+{
+	const QVector<Node>& nodes = box->nodes;
+	if (nodes[node].right != -1) {
+		// The leftmost node of the right subtree.
+		node = nodes[node].right;
+		while (nodes[node].left != -1) {
+			node = nodes[node].left;
+		}
+	} else {
+		// The first ancestor we reach from its left subtree.
+		int child = node;
+		node = nodes[node].parent;
+		while (node != -1 && nodes[node].right == child) {
+			child = node;
+			node = nodes[node].parent;
+		}
+	}
+	return *this;
+}
+
+bool ChoiceBox::const_iterator::operator==(const const_iterator& it) const
+{
+	return node == it.node;
+}
+
+bool ChoiceBox::const_iterator::operator!=(const const_iterator& it) const
+{
+	return node != it.node;
+}
+
+} // namespace ipp3
@@ -0,0 +1,115 @@
+#ifndef IPP3_CHOICEBOX_HPP
+#define IPP3_CHOICEBOX_HPP
+
+#include <QtCore/QVector>
+#include <QtCore/QHash>
+
+namespace ipp3 {
+
+/**
+ * An ordered sequence of distinct integers (phrase indices) with
+ * positional insert, removal and position lookup in O(log n).
+ *
+ * @details
+ * Implemented as an implicit treap with parent links. Every value ever
+ * inserted keeps its node, so moving a phrase in and out of the box does
+ * not allocate.
+ */
+class ChoiceBox
+{
+public:
+	/**
+	 * Walks the values in order using the parent links, without
+	 * allocating. Advancing takes amortized O(1).
+	 */
+	class const_iterator
+	{
+	public:
+		const_iterator();
+		int operator*() const;
+		const_iterator& operator++();
+		bool operator==(const const_iterator& it) const;
+		bool operator!=(const const_iterator& it) const;
+
+	private:
+		const_iterator(const ChoiceBox* box, int node);
+
+		const ChoiceBox* box;
+		int node;
+
+		friend ChoiceBox;
+	};
+
+	ChoiceBox();
+
+	int size() const;
+	bool isEmpty() const;
+	bool contains(int value) const;
+
+	/**
+	 * Value at @a position.
+	 */
+	int at(int position) const;
+
+	/**
+	 * Position of @a value or -1 if it is not in the box.
+	 */
+	int indexOf(int value) const;
+
+	/**
+	 * Inserts @a value (that must not be in the box) before @a position.
+	 */
+	void insert(int position, int value);
+	void append(int value);
+
+	/**
+	 * Removes @a value (that must be in the box).
+	 * @returns former position of the value.
+	 */
+	int remove(int value);
+
+	/**
+	 * Replaces the content with @a values in linear time.
+	 */
+	void assign(const QVector<int>& values);
+
+	/**
+	 * All values in order.
+	 */
+	QVector<int> toVector() const;
+
+	const_iterator begin() const;
+	const_iterator end() const;
+
+	/**
+	 * Estimated heap memory in bytes.
+	 */
+	qint64 memoryUsage() const;
+
+private:
+	struct Node {
+		int value;
+		int left;
+		int right;
+		int parent;
+		int size;
+		quint32 priority;
+		bool isInBox;
+	};
+
+	int nodeFor(int value);
+	int sizeOf(int node) const;
+	void update(int node);
+	void split(int node, int count, int* left, int* right);
+	int merge(int left, int right);
+	quint32 nextPriority();
+
+	QVector<Node> nodes;
+	QHash<int, int> nodeOf;
+	int root;
+	quint32 seed;
+};
+
+} // namespace ipp3
+
+#endif // IPP3_CHOICEBOX_HPP
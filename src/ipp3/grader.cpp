@@ -0,0 +1,216 @@
+#include "grader.hpp"
+#include "trace.hpp"
+
+#include <QtCore/QHash>
+#include <QtCore/QRunnable>
+#include <QtCore/QSemaphore>
+#include <QtCore/QThread>
+#include <QtCore/QThreadPool>
+
+#include <functional>
+#include <vector>
+
+namespace ipp3 {
+
+namespace {
+
+/**
+ * Work handed to a pool thread, releasing @a done when finished.
+ */
+class PoolTask : public QRunnable
+{
+public:
+	PoolTask(const std::function<void()>& work, QSemaphore* done) :
+		work(work), done(done)
+	{
+	}
+
+	virtual void run()
+	{
+		work();
+		done->release();
+	}
+
+private:
+	std::function<void()> work;
+	QSemaphore* done;
+};
+
+} // namespace
+
+Grader::Grader(QSharedPointer<const Bank> bank) :
+	bank_(bank)
+{
+	// Phrases are correct if their words equal the answer, so both are
+	// interned by their joined words.
+	QHash<QString, int> keys;
+	auto key = [&] (const QStringList& words) {
+		QString joined = words.join(' ');
+		auto it = keys.find(joined);
+		if (it == keys.end()) {
+			it = keys.insert(joined, keys.size());
+		}
+		return it.value();
+	};
+
+	for (const Bank::GapData& gd : bank->gaps()) {
+		gapKey.push_back(key(gd.answer));
+		gapTask.push_back(gd.taskIndex);
+	}
+	for (const Bank::PhraseData& pd : bank->phrases()) {
+		phraseKey.push_back(key(pd.words));
+		phraseTask.push_back(pd.taskIndex);
+	}
+	for (const Bank::TaskData& td : bank->tasks()) {
+		taskGapsBegin.push_back(taskGaps.size());
+		taskGaps += td.gapIndices;
+	}
+	taskGapsBegin.push_back(taskGaps.size());
+
+	emptyReport(&total);
+}
+
+QSharedPointer<const Bank> Grader::bank() const
+{
+	return bank_;
+}
+
+int Grader::gapsCount() const
+{
+	return gapKey.size();
+}
+
+void Grader::grade(const int* answers, int count, int* scores, int threads)
+{
+	if (count <= 0)
+		return;
+
+	TraceSpan span("Grader::grade", "grading");
+	span.setArg("submissions", count);
+
+	if (threads <= 0) {
+		threads = QThread::idealThreadCount();
+	}
+	threads = qBound(1, threads, count);
+
+	// Every worker gets a contiguous range and its own report. Workers come
+	// from the global pool, so concurrent calls (the service makes them
+	// from its own pool) share one thread per core instead of each
+	// starting its own.
+	std::vector<Report> reports(threads);
+	QSemaphore done;
+	for (int i = 0; i < threads; ++i) {
+		int begin = qint64(count) * i / threads;
+		int end = qint64(count) * (i + 1) / threads;
+		Report* report = &reports[i];
+		emptyReport(report);
+		if (i == threads - 1) {
+			gradeRange(answers, begin, end, scores, report);
+		} else {
+			QThreadPool::globalInstance()->start(new PoolTask([=] () {
+				gradeRange(answers, begin, end, scores, report);
+			}, &done));
+		}
+	}
+	done.acquire(threads - 1);
+
+	for (const Report& report : reports) {
+		merge(report);
+	}
+}
+
+Grader::Report Grader::report() const
+{
+	QMutexLocker lock(&mutex);
+	return total;
+}
+
+void Grader::emptyReport(Report* report) const
+{
+	report->submissions = 0;
+	report->tasks.fill(TaskStats {0, 0, 0, 0}, taskGapsBegin.size() - 1);
+	report->gaps.fill(GapStats {0, 0, 0}, gapKey.size());
+	report->phrasePicks.fill(0, phraseKey.size());
+}
+
+void Grader::gradeRange(const int* answers, int begin, int end, int* scores, Report* report) const
+{
+	const int gaps = gapKey.size();
+	const int phrases = phraseKey.size();
+	const int tasks = taskGapsBegin.size() - 1;
+
+	// Detaching happens here once, the loop below only writes in place.
+	GapStats* gapStats = report->gaps.data();
+	TaskStats* taskStats = report->tasks.data();
+	qint64* picks = report->phrasePicks.data();
+
+	// A phrase was used in the current submission iff used[phrase] == stamp.
+	QVector<quint32> usedStorage(phrases, 0);
+	quint32* used = usedStorage.data();
+	quint32 stamp = 0;
+
+	for (int s = begin; s < end; ++s) {
+		const int* answer = answers + qint64(s) * gaps;
+		int score = 0;
+		stamp++;
+
+		for (int t = 0; t < tasks; ++t) {
+			int correct = 0;
+			for (int i = taskGapsBegin[t]; i < taskGapsBegin[t + 1]; ++i) {
+				int g = taskGaps[i];
+				int p = answer[g];
+
+				if (p == -1) {
+					gapStats[g].empty++;
+					taskStats[t].empty++;
+				} else if (p < 0 || p >= phrases || phraseTask[p] != t || used[p] == stamp) {
+					gapStats[g].wrong++;
+					taskStats[t].wrong++;
+				} else {
+					used[p] = stamp;
+					picks[p]++;
+					if (phraseKey[p] == gapKey[g]) {
+						correct++;
+						gapStats[g].correct++;
+						taskStats[t].correct++;
+					} else {
+						gapStats[g].wrong++;
+						taskStats[t].wrong++;
+					}
+				}
+			}
+
+			if (correct == taskGapsBegin[t + 1] - taskGapsBegin[t]) {
+				taskStats[t].perfect++;
+			}
+			score += correct;
+		}
+
+		scores[s] = score;
+	}
+
+	report->submissions += end - begin;
+}
+
+void Grader::merge(const Report& report)
+{
+	QMutexLocker lock(&mutex);
+
+	total.submissions += report.submissions;
+	for (int i = 0; i < total.tasks.size(); ++i) {
+		total.tasks[i].correct += report.tasks[i].correct;
+		total.tasks[i].wrong += report.tasks[i].wrong;
+		total.tasks[i].empty += report.tasks[i].empty;
+		total.tasks[i].perfect += report.tasks[i].perfect;
+	}
+	for (int i = 0; i < total.gaps.size(); ++i) {
+		total.gaps[i].correct += report.gaps[i].correct;
+		total.gaps[i].wrong += report.gaps[i].wrong;
+		total.gaps[i].empty += report.gaps[i].empty;
+	}
+	for (int i = 0; i < total.phrasePicks.size(); ++i) {
+		total.phrasePicks[i] += report.phrasePicks[i];
+	}
+}
+
+} // namespace ipp3
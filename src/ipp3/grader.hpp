@@ -0,0 +1,98 @@
+#ifndef IPP3_GRADER_HPP
+#define IPP3_GRADER_HPP
+
+#include <QtCore/QSharedPointer>
+#include <QtCore/QVector>
+#include <QtCore/QMutex>
+
+#include "bank.hpp"
+
+namespace ipp3 {
+
+/**
+ * Grades answer sets against a bank without any GUI.
+ *
+ * @details
+ * An answer set (a submission) is an array with one entry per gap of the
+ * bank: the index of the phrase put into the gap, or -1 if the gap was left
+ * empty. Submissions are graded in bulk on several threads. The answers are
+ * interned when the grader is created, so grading a submission compares
+ * integers only and does not allocate.
+ *
+ * A phrase put into a gap of another task, or into two gaps of the same
+ * submission, is counted as a wrong answer.
+ */
+class Grader
+{
+public:
+	struct GapStats {
+		qint64 correct;
+		qint64 wrong;
+		qint64 empty;
+	};
+
+	struct TaskStats {
+		qint64 correct;
+		qint64 wrong;
+		qint64 empty;
+		// Submissions with all gaps of the task correct.
+		qint64 perfect;
+	};
+
+	struct Report {
+		qint64 submissions;
+		QVector<TaskStats> tasks;
+		QVector<GapStats> gaps;
+		// How many times each phrase was put into a gap.
+		QVector<qint64> phrasePicks;
+	};
+
+	Grader(QSharedPointer<const Bank> bank);
+
+	QSharedPointer<const Bank> bank() const;
+
+	/**
+	 * Number of entries in one submission (gaps in the bank).
+	 */
+	int gapsCount() const;
+
+	/**
+	 * Grades @a count submissions stored back to back in @a answers and
+	 * adds them to the statistics. The number of correct gaps of each
+	 * submission is written to @a scores. Uses up to @a threads threads,
+	 * or one per core when 0: the calling one and those of the global
+	 * QThreadPool, which concurrent calls share.
+	 *
+	 * Can be called from several threads at once, but not from a thread of
+	 * the global pool.
+	 */
+	void grade(const int* answers, int count, int* scores, int threads = 0);
+
+	/**
+	 * Statistics of everything graded so far.
+	 */
+	Report report() const;
+
+private:
+	void emptyReport(Report* report) const;
+	void gradeRange(const int* answers, int begin, int end, int* scores, Report* report) const;
+	void merge(const Report& report);
+
+	QSharedPointer<const Bank> bank_;
+
+	// Flattened bank: interned answers and task membership.
+	QVector<int> gapKey;
+	QVector<int> gapTask;
+	QVector<int> phraseKey;
+	QVector<int> phraseTask;
+	// Gaps of task t are taskGaps[taskGapsBegin[t] .. taskGapsBegin[t + 1]).
+	QVector<int> taskGapsBegin;
+	QVector<int> taskGaps;
+
+	mutable QMutex mutex;
+	Report total;
+};
+
+} // namespace ipp3
+
+#endif // IPP3_GRADER_HPP
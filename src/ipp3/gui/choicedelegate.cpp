@@ -0,0 +1,47 @@
+#include "choicedelegate.hpp"
+#include "choicemodel.hpp"
+#include "gap.hpp"
+#include "../trace.hpp"
+
+#include <QtGui/QPainter>
+
+namespace ipp3 {
+namespace gui {
+
+ChoiceDelegate::ChoiceDelegate(QObject* parent) :
+	QStyledItemDelegate(parent)
+{
+}
+
+void ChoiceDelegate::paint(QPainter* painter, const QStyleOptionViewItem& option,
+						   const QModelIndex& index) const
+{
+	IPP3_TRACE("ChoiceDelegate::paint", "paint");
+
+	const int inset = Gap::borderWidth / 2;
+	QRect frame = option.rect.adjusted(inset, inset, -inset, -inset);
+
+	painter->save();
+	painter->setRenderHint(QPainter::Antialiasing);
+	painter->setPen(QPen(option.palette.color(QPalette::WindowText), Gap::borderWidth));
+	if (index.data(ChoiceModel::ChosenRole).toBool()) {
+		painter->setBrush(QColor(Gap::chosenBackgroundColor));
+	} else {
+		painter->setBrush(Qt::NoBrush);
+	}
+	painter->drawRoundedRect(frame, Gap::borderRadius, Gap::borderRadius);
+
+	painter->setFont(option.font);
+	painter->drawText(option.rect, Qt::AlignCenter, index.data().toString());
+	painter->restore();
+}
+
+QSize ChoiceDelegate::sizeHint(const QStyleOptionViewItem& option, const QModelIndex& index) const
+{
+	const int frame = 2 * (Gap::borderWidth + Gap::padding);
+	QSize text = option.fontMetrics.size(Qt::TextSingleLine, index.data().toString());
+	return text + QSize(frame + 2 * Gap::padding, frame);
+}
+
+} // namespace gui
+} // namespace ipp3
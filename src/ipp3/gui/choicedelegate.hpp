@@ -0,0 +1,27 @@
+#ifndef IPP3_GUI_CHOICEDELEGATE_HPP
+#define IPP3_GUI_CHOICEDELEGATE_HPP
+
+#include <QtWidgets/QStyledItemDelegate>
+
+namespace ipp3 {
+namespace gui {
+
+/**
+ * Paints a choice the same way gaps are painted: a rounded frame around
+ * the phrase, highlighted when chosen.
+ */
+class ChoiceDelegate : public QStyledItemDelegate
+{
+	Q_OBJECT
+public:
+	ChoiceDelegate(QObject* parent = nullptr);
+
+	virtual void paint(QPainter* painter, const QStyleOptionViewItem& option,
+					   const QModelIndex& index) const;
+	virtual QSize sizeHint(const QStyleOptionViewItem& option, const QModelIndex& index) const;
+};
+
+} // namespace gui
+} // namespace ipp3
+
+#endif // IPP3_GUI_CHOICEDELEGATE_HPP
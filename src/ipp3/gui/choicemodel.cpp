@@ -0,0 +1,96 @@
+#include "choicemodel.hpp"
+#include "../trace.hpp"
+
+namespace ipp3 {
+namespace gui {
+
+ChoiceModel::ChoiceModel(Model* model, QObject* parent) :
+	QAbstractListModel(parent),
+	model_(model),
+	chosenRow_(-1)
+{
+	reload();
+}
+
+void ChoiceModel::reload()
+{
+	IPP3_TRACE("ChoiceModel::reload", "gui");
+	beginResetModel();
+	if (filter.isEmpty()) {
+		rows = model_->currentTask().choices();
+	} else {
+		rows = model_->currentTask().choicesWithPrefix(filter);
+	}
+	chosenRow_ = -1;
+	endResetModel();
+}
+
+void ChoiceModel::setFilter(const QString& prefix)
+{
+	filter = prefix;
+	reload();
+}
+
+Model::Phrase ChoiceModel::phrase(int row) const
+{
+	return rows[row];
+}
+
+void ChoiceModel::removeChoice(int row)
+{
+	Q_ASSERT(row >= 0 && row < rows.size());
+
+	beginRemoveRows(QModelIndex(), row, row);
+	rows.remove(row);
+	if (chosenRow_ == row) {
+		chosenRow_ = -1;
+	} else if (chosenRow_ > row) {
+		chosenRow_--;
+	}
+	endRemoveRows();
+}
+
+int ChoiceModel::chosenRow() const
+{
+	return chosenRow_;
+}
+
+void ChoiceModel::setChosenRow(int row)
+{
+	int old = chosenRow_;
+	chosenRow_ = row;
+
+	if (old != -1) {
+		dataChanged(index(old), index(old), {ChosenRole});
+	}
+	if (row != -1) {
+		dataChanged(index(row), index(row), {ChosenRole});
+	}
+}
+
+int ChoiceModel::rowCount(const QModelIndex& parent) const
+{
+	if (parent.isValid())
+		return 0;
+	return rows.size();
+}
+
+QVariant ChoiceModel::data(const QModelIndex& index, int role) const
+{
+	if (!index.isValid() || index.row() >= rows.size())
+		return QVariant();
+
+	switch (role) {
+		case Qt::DisplayRole:
+			return rows[index.row()].words().join(' ');
+
+		case ChosenRole:
+			return index.row() == chosenRow_;
+
+		default:
+			return QVariant();
+	}
+}
+
+} // namespace gui
+} // namespace ipp3
@@ -0,0 +1,70 @@
+#ifndef IPP3_GUI_CHOICEMODEL_HPP
+#define IPP3_GUI_CHOICEMODEL_HPP
+
+#include <QtCore/QAbstractListModel>
+
+#include "../model.hpp"
+
+namespace ipp3 {
+namespace gui {
+
+/**
+ * Item model exposing the choices of the current task to a view.
+ *
+ * @details
+ * No widget is created per choice, the view only paints the visible rows.
+ * When a filter is set, rows come from the task's prefix index.
+ */
+class ChoiceModel : public QAbstractListModel
+{
+	Q_OBJECT
+public:
+	enum Role
+	{
+		/**
+		 * Whether the row is the chosen one (bool).
+		 */
+		ChosenRole = Qt::UserRole
+	};
+
+	ChoiceModel(Model* model, QObject* parent = nullptr);
+
+	/**
+	 * Rebuilds the rows from the current task of the model.
+	 */
+	void reload();
+
+	/**
+	 * Shows only the choices starting with @a prefix (case insensitive).
+	 */
+	void setFilter(const QString& prefix);
+
+	Model::Phrase phrase(int row) const;
+
+	/**
+	 * Removes a row after its phrase was taken out of the choice box.
+	 */
+	void removeChoice(int row);
+
+	/**
+	 * The chosen row, or -1.
+	 */
+	//@{
+	int chosenRow() const;
+	void setChosenRow(int row);
+	//@}
+
+	virtual int rowCount(const QModelIndex& parent = QModelIndex()) const;
+	virtual QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const;
+
+private:
+	Model* model_;
+	QString filter;
+	QVector<Model::Phrase> rows;
+	int chosenRow_;
+};
+
+} // namespace gui
+} // namespace ipp3
+
+#endif // IPP3_GUI_CHOICEMODEL_HPP
@@ -41,6 +41,7 @@
 #include <QtWidgets>
 
 #include "flowlayout.hpp"
+#include "../trace.hpp"
 
 namespace ipp3 {
 namespace gui {
@@ -153,6 +154,9 @@ void FlowLayout::clear()
 
 int FlowLayout::doLayout(const QRect& rect, bool testOnly) const
 {
+	TraceSpan span("FlowLayout::doLayout", "layout");
+	span.setArg("items", itemList.size());
+
 	int left, top, right, bottom;
 	getContentsMargins(&left, &top, &right, &bottom);
 	QRect effectiveRect = rect.adjusted(+left, +top, -right, -bottom);
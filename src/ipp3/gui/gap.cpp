@@ -1,7 +1,9 @@
 #include "gap.hpp"
+#include "../trace.hpp"
 
 #include <QtWidgets/QLabel>
 #include <QtWidgets/QStackedLayout>
+#include <QtWidgets/QApplication>
 
 namespace ipp3 {
 namespace gui {
@@ -14,16 +16,30 @@ Gap::Gap(Model::Gap modelGap) :
 	label = new QLabel();
 	layout()->addWidget(label);
 	if (modelGap.hasImage()) {
-		pixmap = QPixmap::fromImage(modelGap.image()).scaled(200, 100, Qt::KeepAspectRatio);
+		// The image is usually decoded at imageSize() already.
+		qreal ratio = devicePixelRatioF();
+		pixmap = QPixmap::fromImage(modelGap.image()).scaled(
+			QSize(imageWidth, imageHeight) * ratio, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+		pixmap.setDevicePixelRatio(ratio);
 	}
 	refresh(false);
 }
 
+QSize Gap::imageSize()
+{
+	return QSize(imageWidth, imageHeight) * qApp->devicePixelRatio();
+}
+
 Model::Gap Gap::modelGap() const
 {
 	return modelGap_;
 }
 
+const QPixmap& Gap::cachedPixmap() const
+{
+	return pixmap;
+}
+
 void Gap::refresh(bool isChosen)
 {
 	QString style = "border-style:%1; border-radius: %2px; border-width: %3px; padding: %4px; ";
@@ -56,6 +72,7 @@ void Gap::refresh(bool isChosen)
 
 void Gap::paintEvent(QPaintEvent* e)
 {
+	IPP3_TRACE("Gap::paintEvent", "paint");
 	QWidget::paintEvent(e);
 }
 
@@ -19,12 +19,24 @@ public:
 	static const int borderRadius = 5;
 	static const int borderWidth = 2;
 	static const int padding = 2;
+	static const int imageWidth = 200;
+	static const int imageHeight = 100;
+
+	/**
+	 * Size images are shown at, in device pixels of the primary screen.
+	 */
+	static QSize imageSize();
 
 	Gap(Model::Gap modelGap);
 	Model::Gap modelGap() const;
 
 	void refresh(bool isChosen);
 
+	/**
+	 * The image scaled for display, null if the gap has no image.
+	 */
+	const QPixmap& cachedPixmap() const;
+
 private:
 	virtual void paintEvent(QPaintEvent* e);
 
@@ -1,10 +1,16 @@
 #include "mainwindow.hpp"
 #include "startscreen.hpp"
 #include "testview.hpp"
-#include "../ltf/parser.hpp"
+#include "gap.hpp"
 #include "../model.hpp"
+#include "../journal.hpp"
+#include "../trace.hpp"
 
 #include <QtWidgets/QMessageBox>
+#include <QtWidgets/QStatusBar>
+#include <QtCore/QSet>
+
+#include <random>
 
 namespace ipp3 {
 namespace gui {
@@ -26,31 +32,80 @@ MainWindow::~MainWindow()
 
 void MainWindow::testFileChosen(const QString& fileName)
 {
-	QFile file(fileName);
-	if (!file.open(QFile::ReadOnly)) {
-		QMessageBox::critical(this, tr("Error"), tr("Cannot open the file %1.").arg(fileName));
+	IPP3_TRACE("MainWindow::open", "load");
+
+	// Images are decoded at the size gaps show them.
+	QString error;
+	QSharedPointer<const Bank> bank = Bank::load(fileName, Bank::Images::Load, &error, Gap::imageSize());
+	if (!bank) {
+		QMessageBox::critical(this, tr("Error"), error);
+		return;
+	}
+
+	showTest(bank, fileName, Journal::pathFor(QFileInfo(fileName).absoluteFilePath()));
+}
+
+void MainWindow::openExam(const QString& fileName, int count)
+{
+	IPP3_TRACE("MainWindow::openExam", "load");
+
+	QString error;
+	int total = Bank::tasksCount(fileName, &error);
+	if (total < 0) {
+		QMessageBox::critical(this, tr("Error"), error);
 		return;
 	}
 
-	QTextStream stream(&file);
-	ltf::Document doc;
-	ltf::Parser parser;
-	try {
-		doc = parser.parse(&stream);
-	} catch (const ltf::ParserError& error) {
-		QMessageBox::critical(this, tr("Error"), 
-			tr("An error was encountered when reading the test file:\n%1").arg(error.message()));
+	// Distinct tasks in random order, drawn without listing all of them.
+	count = qBound(0, count, total);
+	std::mt19937 random(std::random_device {}());
+	std::uniform_int_distribution<int> pick(0, total - 1);
+	QSet<int> drawn;
+	QVector<int> tasks;
+	while (tasks.size() < count) {
+		int task = pick(random);
+		if (!drawn.contains(task)) {
+			drawn.insert(task);
+			tasks.append(task);
+		}
+	}
+
+	QSharedPointer<const Bank> bank = Bank::loadTasks(fileName, tasks, Bank::Images::Load, &error,
+													  Gap::imageSize());
+	if (!bank) {
+		QMessageBox::critical(this, tr("Error"), error);
 		return;
 	}
 
-	QFileInfo fileInfo(file);
-	Model* model = new Model(doc, fileInfo.dir());
+	// Exams get their own journal, resumed only for the same tasks (the
+	// snapshot checks the content).
+	showTest(bank, fileName, Journal::pathFor(QFileInfo(fileName).absoluteFilePath() + ".exam"));
+}
+
+void MainWindow::showTest(const QSharedPointer<const Bank>& bank, const QString& fileName,
+						  const QString& journalPath)
+{
+	QFileInfo fileInfo(fileName);
+	Model* model = new Model(bank);
+
+	QStringList warnings = model->bank()->warnings();
+	if (!warnings.isEmpty()) {
+		QMessageBox::warning(this, tr("Warning"), warnings.join('\n'));
+	}
+
+	// Pick up where the previous session on this file ended.
+	Journal* journal = new Journal(journalPath);
+	bool resumed = journal->resume(model);
+	journal->attach(model);
 
 	clearContent();
-	testView = new TestView(model);
+	testView = new TestView(model, journal);
 
 	setCentralWidget(testView);
 	testView->show();
+	if (resumed) {
+		testView->statusBar()->showMessage(tr("Restored the previous session."), 5000);
+	}
 
 	setWindowTitle(windowTitle() + " - " + fileInfo.absoluteFilePath());
 	showMaximized();
@@ -2,8 +2,12 @@
 #define IPP3_GUI_MAINWINDOW_HPP
 
 #include <QtWidgets/QMainWindow>
+#include <QtCore/QSharedPointer>
 
 namespace ipp3 {
+
+class Bank;
+
 namespace gui {
 
 class StartScreen;
@@ -19,8 +23,16 @@ public:
 	MainWindow();
 	~MainWindow();
 
+	/**
+	 * Opens a test of @a count tasks drawn at random from a test file,
+	 * reading only those tasks.
+	 */
+	void openExam(const QString& fileName, int count);
+
 private:
 	void testFileChosen(const QString& fileName);
+	void showTest(const QSharedPointer<const Bank>& bank, const QString& fileName,
+				  const QString& journalPath);
 	void clearContent();
 
 	StartScreen* startScreen;
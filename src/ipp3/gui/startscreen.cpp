@@ -22,7 +22,7 @@ StartScreen::~StartScreen()
 void StartScreen::showOpenFileDialog()
 {
 	QString fileName = QFileDialog::getOpenFileName(
-		this, tr("Open test file"), {}, tr("Language tests (*.ltf)"));
+		this, tr("Open test file"), {}, tr("Language tests (*.ltf *.ltfb)"));
 
 	if (!fileName.isNull()) {
 		testFileChosen(fileName);
@@ -0,0 +1,52 @@
+#include "taskdelegate.hpp"
+#include "taskmodel.hpp"
+#include "../trace.hpp"
+
+#include <QtWidgets/QApplication>
+#include <QtWidgets/QStyleOption>
+
+namespace ipp3 {
+namespace gui {
+
+TaskDelegate::TaskDelegate(QObject* parent) :
+	QStyledItemDelegate(parent)
+{
+}
+
+void TaskDelegate::paint(QPainter* painter, const QStyleOptionViewItem& option,
+						 const QModelIndex& index) const
+{
+	IPP3_TRACE("TaskDelegate::paint", "paint");
+
+	QStyleOptionButton button;
+	button.rect = option.rect.adjusted(1, 1, -1, -1);
+	button.text = index.data().toString();
+	button.fontMetrics = option.fontMetrics;
+	button.palette = option.palette;
+	button.state = QStyle::State_Raised | (option.state & QStyle::State_MouseOver);
+	if (!index.data(TaskModel::CurrentRole).toBool()) {
+		button.state |= QStyle::State_Enabled;
+	}
+	if (index.data(TaskModel::FinishedRole).toBool()) {
+		button.palette.setColor(QPalette::Button, QColor("DarkGrey"));
+	}
+
+	QStyle* style = option.widget ? option.widget->style() : QApplication::style();
+	style->drawControl(QStyle::CE_PushButton, &button, painter, option.widget);
+}
+
+QSize TaskDelegate::sizeHint(const QStyleOptionViewItem& option, const QModelIndex& index) const
+{
+	// All cells have the same size, wide enough for five digits, so the
+	// view can lay them out without asking every row.
+	Q_UNUSED(index);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 11, 0)
+	int digitsWidth = option.fontMetrics.horizontalAdvance("00000");
+#else
+	int digitsWidth = option.fontMetrics.width("00000");
+#endif
+	return QSize(digitsWidth + 12, qMax(20, option.fontMetrics.height() + 8));
+}
+
+} // namespace gui
+} // namespace ipp3
@@ -0,0 +1,27 @@
+#ifndef IPP3_GUI_TASKDELEGATE_HPP
+#define IPP3_GUI_TASKDELEGATE_HPP
+
+#include <QtWidgets/QStyledItemDelegate>
+
+namespace ipp3 {
+namespace gui {
+
+/**
+ * Paints a task cell as a push button: disabled for the current task and
+ * grey for finished ones, like the buttons the navigator used to have.
+ */
+class TaskDelegate : public QStyledItemDelegate
+{
+	Q_OBJECT
+public:
+	TaskDelegate(QObject* parent = nullptr);
+
+	virtual void paint(QPainter* painter, const QStyleOptionViewItem& option,
+					   const QModelIndex& index) const;
+	virtual QSize sizeHint(const QStyleOptionViewItem& option, const QModelIndex& index) const;
+};
+
+} // namespace gui
+} // namespace ipp3
+
+#endif // IPP3_GUI_TASKDELEGATE_HPP
@@ -0,0 +1,82 @@
+#include "taskmodel.hpp"
+
+#include <algorithm>
+
+namespace ipp3 {
+namespace gui {
+
+TaskModel::TaskModel(Model* model, QObject* parent) :
+	QAbstractListModel(parent),
+	model_(model),
+	isFiltered(false)
+{
+}
+
+void TaskModel::setFilter(const QVector<int>& tasks)
+{
+	beginResetModel();
+	isFiltered = true;
+	rows = tasks;
+	endResetModel();
+}
+
+void TaskModel::clearFilter()
+{
+	beginResetModel();
+	isFiltered = false;
+	rows.clear();
+	endResetModel();
+}
+
+Model::Task TaskModel::task(int row) const
+{
+	return model_->task(isFiltered ? rows[row] : row);
+}
+
+void TaskModel::taskChanged(Model::Task task)
+{
+	int row = rowOf(task.index());
+	if (row != -1) {
+		dataChanged(index(row), index(row), {FinishedRole, CurrentRole});
+	}
+}
+
+int TaskModel::rowOf(int taskIndex) const
+{
+	if (!isFiltered)
+		return taskIndex;
+
+	auto it = std::lower_bound(rows.begin(), rows.end(), taskIndex);
+	return it != rows.end() && *it == taskIndex ? it - rows.begin() : -1;
+}
+
+int TaskModel::rowCount(const QModelIndex& parent) const
+{
+	if (parent.isValid())
+		return 0;
+	return isFiltered ? rows.size() : model_->tasksCount();
+}
+
+QVariant TaskModel::data(const QModelIndex& index, int role) const
+{
+	if (!index.isValid() || index.row() >= rowCount())
+		return QVariant();
+
+	Model::Task task = this->task(index.row());
+	switch (role) {
+		case Qt::DisplayRole:
+			return QString::number(task.index() + 1);
+
+		case FinishedRole:
+			return task.isFinished();
+
+		case CurrentRole:
+			return task == model_->currentTask();
+
+		default:
+			return QVariant();
+	}
+}
+
+} // namespace gui
+} // namespace ipp3
@@ -0,0 +1,70 @@
+#ifndef IPP3_GUI_TASKMODEL_HPP
+#define IPP3_GUI_TASKMODEL_HPP
+
+#include <QtCore/QAbstractListModel>
+
+#include "../model.hpp"
+
+namespace ipp3 {
+namespace gui {
+
+/**
+ * Item model exposing the tasks of a model to the task navigator.
+ *
+ * @details
+ * Rows are task numbers, computed on demand, so there is nothing to build
+ * per task. Changes of a task are announced with taskChanged(), which
+ * repaints only that cell. When a filter is set, only the given tasks are
+ * shown.
+ */
+class TaskModel : public QAbstractListModel
+{
+	Q_OBJECT
+public:
+	enum Role
+	{
+		/**
+		 * Whether the task is finished (bool).
+		 */
+		FinishedRole = Qt::UserRole,
+
+		/**
+		 * Whether the task is the current one (bool).
+		 */
+		CurrentRole
+	};
+
+	TaskModel(Model* model, QObject* parent = nullptr);
+
+	/**
+	 * Shows only @a tasks, which must be sorted.
+	 */
+	void setFilter(const QVector<int>& tasks);
+
+	/**
+	 * Shows all tasks again.
+	 */
+	void clearFilter();
+
+	Model::Task task(int row) const;
+
+	/**
+	 * Repaints the cell of a task (if shown) after its state changed.
+	 */
+	void taskChanged(Model::Task task);
+
+	virtual int rowCount(const QModelIndex& parent = QModelIndex()) const;
+	virtual QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const;
+
+private:
+	int rowOf(int taskIndex) const;
+
+	Model* model_;
+	bool isFiltered;
+	QVector<int> rows;
+};
+
+} // namespace gui
+} // namespace ipp3
+
+#endif // IPP3_GUI_TASKMODEL_HPP
@@ -1,35 +1,54 @@
 #include "testview.hpp"
 #include "flowlayout.hpp"
 #include "gap.hpp"
-#include "choice.hpp"
+#include "choicemodel.hpp"
+#include "choicedelegate.hpp"
+#include "taskmodel.hpp"
+#include "taskdelegate.hpp"
 #include "ui_testview.h"
 #include "../model.hpp"
+#include "../journal.hpp"
+#include "../trace.hpp"
+#include "../searchindex.hpp"
 
 #include <QtWidgets/QLabel>
+#include <QtWidgets/QListView>
+#include <QtWidgets/QMenu>
+#include <QtWidgets/QMenuBar>
+#include <QtWidgets/QMessageBox>
+#include <QtWidgets/QLineEdit>
+#include <QtWidgets/QStatusBar>
 #include <QtCore/QDebug>
 
 namespace ipp3 {
 namespace gui {
 
-TestView::TestView(Model* model) : 
-	model_(model)
+TestView::TestView(Model* model, Journal* journal) :
+	model_(model),
+	journal_(journal),
+	journalFailureShown(false),
+	searchIndex_(nullptr)
 {
 	qDebug() << "creating TestView";
 
 	ui = new Ui::TestView();
 	ui->setupUi(this);
 	textLayout = new FlowLayout(ui->text);
-	choiceLayout = new FlowLayout(ui->choices);
-	setupButtonsGrid();
+	setupTaskNavigator();
+	setupSearch();
+	setupChoices();
+	setupDebugMenu();
 	rebuild();
 
 	// buttons
 	connect(ui->finishButton, &QPushButton::clicked, [=] () { 
 		model->finish(); 
+		taskModel->taskChanged(model->currentTask());
 		refresh();
 	});
 	connect(ui->resetButton, &QPushButton::clicked, [=] () {
 		model->reset();
+		taskModel->taskChanged(model->currentTask());
 		rebuild();
 	});
 	connect(ui->nextButton, &QPushButton::clicked, [=] () {
@@ -40,9 +59,14 @@ TestView::TestView(Model* model) :
 TestView::~TestView()
 {
 	qDebug() << "destroying TestView";
+	if (searchIndexBuilder.joinable()) {
+		searchIndexBuilder.join();
+	}
+	delete searchIndex_;
+	model_->setJournal(nullptr);
+	delete journal_;
 	delete model_;
 	delete textLayout;
-	delete choiceLayout;
 	delete ui;
 }
 
@@ -53,7 +77,10 @@ Model* TestView::model()
 
 void TestView::switchTask(Model::Task task)
 {
+	Model::Task previous = model()->currentTask();
 	model()->switchTask(task);
+	taskModel->taskChanged(previous);
+	taskModel->taskChanged(task);
 	rebuild();
 }
 
@@ -64,24 +91,18 @@ static QString formatScore(int correct, int total, const QString& color)
 
 void TestView::rebuild()
 {
+	IPP3_TRACE("TestView::rebuild", "gui");
 	buildText();
-	buildChoices();
+	choiceModel->reload();
 	chosenGap = nullptr;
-	chosenChoice = nullptr;
 	refresh();
 }
 
 void TestView::refresh()
 {
+	IPP3_TRACE("TestView::refresh", "gui");
 	// update "The End!" label
-	bool allFinished = true;
-	for (Model::Task task : model()->tasks()) {
-		if (!task.isFinished()) {
-			allFinished = false;
-			break;
-		}
-	}
-	ui->theEndLabel->setVisible(allFinished);
+	ui->theEndLabel->setVisible(model()->finishedTasks() == model()->tasksCount());
 
 	// update background color
 	QString style = "background-color: White;";
@@ -93,17 +114,6 @@ void TestView::refresh()
 		ui->text->setStyleSheet(style);
 	}
 
-	// update buttons grid
-	for (auto pair : buttons) {
-		pair.first->setEnabled(pair.second != model()->currentTask());
-
-		if (pair.second.isFinished()) {
-			pair.first->setStyleSheet("background-color: DarkGrey");
-		} else {
-			pair.first->setStyleSheet("");
-		}
-	}
-
 	// update check/next buttons
 	bool finished = model()->currentTask().isFinished();
 	ui->finishButton->setEnabled(!finished);
@@ -125,36 +135,125 @@ void TestView::refresh()
 		ui->thisTestScore->hide();
 	}
 
-	// refresh gaps and choices
+	// refresh gaps, choices repaint themselves from the item model
 	for (Gap* gap : gaps) {
 		gap->refresh(chosenGap == gap);
 	}
-	for (Choice* choice : choices) {
-		choice->refresh(chosenChoice == choice);
-	}
 
 	update();
+
+	// Told once, the message stays until another replaces it.
+	if (journal_ && journal_->isFailing() && !journalFailureShown) {
+		journalFailureShown = true;
+		statusBar()->showMessage(tr("Your answers cannot be saved, they will be lost if the program stops."));
+	}
 }
 
-void TestView::setupButtonsGrid()
+void TestView::setupTaskNavigator()
 {
-	for (Model::Task task : model()->tasks()) {
-		QPushButton* button = new QPushButton(tr("%n", nullptr, task.index() + 1));
-		button->setSizePolicy(QSizePolicy::Preferred, QSizePolicy::Preferred);
-		button->setMinimumSize(10, 20);
-		connect(button, &QPushButton::clicked, [=] () { switchTask(task); });
-		ui->buttonsGrid->addWidget(button, task.index() / 4, task.index() % 4);
-		buttons.push_back(qMakePair(button, task));
+	IPP3_TRACE("TestView::setupTaskNavigator", "gui");
+	taskModel = new TaskModel(model(), this);
+
+	// Cells have a uniform size, so only the visible ones are ever asked
+	// for data or painted.
+	QListView* view = ui->tasks;
+	view->setModel(taskModel);
+	view->setItemDelegate(new TaskDelegate(view));
+	view->setViewMode(QListView::ListMode);
+	view->setFlow(QListView::LeftToRight);
+	view->setWrapping(true);
+	view->setResizeMode(QListView::Adjust);
+	view->setUniformItemSizes(true);
+	view->setSelectionMode(QAbstractItemView::NoSelection);
+	view->setEditTriggers(QAbstractItemView::NoEditTriggers);
+	view->setMouseTracking(true);
+	view->viewport()->setAttribute(Qt::WA_Hover);
+
+	connect(view, &QListView::clicked, this, &TestView::taskClicked);
+}
+
+void TestView::setupSearch()
+{
+	// Most views are never searched, so the index is built off the GUI
+	// thread and waited for only on the first search.
+	QSharedPointer<const Bank> bank = model()->bank();
+	searchIndexBuilder = std::thread([=] () {
+		searchIndex_ = new SearchIndex(*bank);
+	});
+
+	connect(ui->taskSearch, &QLineEdit::textChanged, this, &TestView::filterTasks);
+}
+
+const SearchIndex& TestView::searchIndex()
+{
+	if (searchIndexBuilder.joinable()) {
+		searchIndexBuilder.join();
 	}
+	return *searchIndex_;
 }
 
-void TestView::clearChoices()
+void TestView::filterTasks(const QString& query)
 {
-	choiceLayout->clear();
-	for (Choice* choice : choices) {
-		delete choice;
+	IPP3_TRACE("TestView::filterTasks", "gui");
+	if (query.trimmed().isEmpty()) {
+		taskModel->clearFilter();
+	} else {
+		taskModel->setFilter(searchIndex().search(query));
 	}
-	choices.clear();
+}
+
+void TestView::setupDebugMenu()
+{
+	QMenu* menu = ui->menubar->addMenu(tr("&Debug"));
+	QAction* action = menu->addAction(tr("&Memory report..."));
+	action->setShortcut(QKeySequence(tr("Ctrl+Shift+M")));
+	connect(action, &QAction::triggered, this, &TestView::showMemoryReport);
+}
+
+MemoryReport TestView::memoryReport() const
+{
+	MemoryReport report = model_->memoryReport();
+
+	// The view itself counts as a widget too.
+	int widgets = findChildren<QWidget*>().size() + 1;
+	report.add(MemoryReport::Widgets, qint64(widgets) * MemoryReport::estimatedWidgetBytes, widgets);
+
+	for (Gap* gap : gaps) {
+		report.addPixmap(MemoryReport::Pixmaps, gap->cachedPixmap());
+	}
+
+	return report;
+}
+
+void TestView::showMemoryReport()
+{
+	QMessageBox box(this);
+	box.setWindowTitle(tr("Memory report"));
+	box.setTextFormat(Qt::RichText);
+	box.setText("<pre>" + memoryReport().toString().toHtmlEscaped() + "</pre>");
+	box.exec();
+}
+
+void TestView::setupChoices()
+{
+	choiceModel = new ChoiceModel(model(), this);
+
+	QListView* view = ui->choices;
+	view->setModel(choiceModel);
+	view->setItemDelegate(new ChoiceDelegate(view));
+	view->setViewMode(QListView::ListMode);
+	view->setFlow(QListView::LeftToRight);
+	view->setWrapping(true);
+	view->setResizeMode(QListView::Adjust);
+	view->setLayoutMode(QListView::Batched);
+	view->setSpacing(3);
+	view->setSelectionMode(QAbstractItemView::NoSelection);
+	view->setEditTriggers(QAbstractItemView::NoEditTriggers);
+	view->setFocusPolicy(Qt::NoFocus);
+	view->viewport()->setCursor(QCursor(Qt::PointingHandCursor));
+
+	connect(view, &QListView::clicked, this, &TestView::choiceClicked);
+	connect(ui->choiceFilter, &QLineEdit::textChanged, choiceModel, &ChoiceModel::setFilter);
 }
 
 void TestView::clearText()
@@ -170,20 +269,11 @@ void TestView::clearText()
 	gaps.clear();
 }
 
-void TestView::buildChoices()
-{
-	clearChoices();
-
-	for (Model::Phrase modelChoice : model()->currentTask().choices()) {
-		addChoice(modelChoice);
-	}
-}
-
 void TestView::buildText()
 {
 	clearText();
 
-	for (auto elem : model()->currentTask().text()) {
+	for (Model::TextElement elem : model()->currentTask().textRange()) {
 		if (elem.isLeft()) {
 			addWord(elem.left());
 		} else {
@@ -192,15 +282,6 @@ void TestView::buildText()
 	}
 }
 
-Choice* TestView::addChoice(ipp3::Model::Phrase modelChoice)
-{
-	Choice* choice = new Choice(modelChoice);
-	connect(choice, &Choice::clicked, [=] () { choiceClicked(choice); });
-	choiceLayout->addWidget(choice);
-	choices.insert(choice);
-	return choice;
-}
-
 void TestView::addWord(const QString& word)
 {
 	QLabel* label = new QLabel(word);
@@ -224,14 +305,12 @@ void TestView::gapClicked(Gap* gap)
 	if (model()->currentTask().isFinished())
 		return;
 
-	if (chosenChoice) {
+	int chosenChoice = choiceModel->chosenRow();
+	if (chosenChoice != -1) {
 		// Insert a phrase to the gap.
 		if (gap->modelGap().isEmpty()) {
-			model()->insert(chosenChoice->modelPhrase(), gap->modelGap());
-			choiceLayout->removeWidget(chosenChoice);
-			choices.remove(chosenChoice);
-			delete chosenChoice;
-			chosenChoice = nullptr;
+			model()->insert(choiceModel->phrase(chosenChoice), gap->modelGap());
+			choiceModel->removeChoice(chosenChoice);
 		}
 	} else if (chosenGap) {
 		// Swap a phrase between gaps (it does nothing if the gaps are equal).
@@ -247,16 +326,24 @@ void TestView::gapClicked(Gap* gap)
 	refresh();
 }
 
-void TestView::choiceClicked(Choice* choice)
+void TestView::taskClicked(const QModelIndex& index)
+{
+	Model::Task task = taskModel->task(index.row());
+	if (task != model()->currentTask()) {
+		switchTask(task);
+	}
+}
+
+void TestView::choiceClicked(const QModelIndex& index)
 {
 	if (model()->currentTask().isFinished())
 		return;
 
-	if (chosenChoice == choice) {
-		chosenChoice = nullptr;
+	if (choiceModel->chosenRow() == index.row()) {
+		choiceModel->setChosenRow(-1);
 	} else {
 		chosenGap = nullptr;
-		chosenChoice = choice;
+		choiceModel->setChosenRow(index.row());
 	}
 
 	refresh();
@@ -2,10 +2,11 @@
 #define IPP3_GUI_TESTVIEW_HPP
 
 #include <QtWidgets/QMainWindow>
-#include <QtWidgets/QPushButton>
 #include <QtWidgets/QLabel>
 #include <QtCore/QSet>
 
+#include <thread>
+
 #include "../model.hpp"
 
 namespace Ui {
@@ -13,54 +14,74 @@ class TestView;
 }
 
 namespace ipp3 {
+
+class Journal;
+class SearchIndex;
+
 namespace gui {
 class FlowLayout;
 class Gap;
-class Choice;
+class ChoiceModel;
+class TaskModel;
 
 class TestView : public QMainWindow
 {
 	Q_OBJECT
 public:
-	TestView(Model* model);
+	/**
+	 * Takes ownership of the model and the journal (which may be null).
+	 */
+	TestView(Model* model, Journal* journal = nullptr);
 	~TestView();
 
 	Model* model();
 
 	void switchTask(Model::Task task);
 
+	/**
+	 * Memory used by the model and by this view (widgets and pixmaps).
+	 */
+	MemoryReport memoryReport() const;
+
 private:
 	void rebuild();
 	void refresh();
 
-	void setupButtonsGrid();
+	void setupTaskNavigator();
+	void setupSearch();
+	const SearchIndex& searchIndex();
+	void filterTasks(const QString& query);
+	void setupDebugMenu();
+	void showMemoryReport();
 
-	void clearChoices();
+	void setupChoices();
 	void clearText();
-
-	void buildChoices();
 	void buildText();
 
-	Choice* addChoice(Model::Phrase modelChoice);
 	void addWord(const QString& word);
 	void addGap(Model::Gap modelGap);
 
 	void gapClicked(Gap* gap);
-	void choiceClicked(Choice* choice);
+	void choiceClicked(const QModelIndex& index);
+	void taskClicked(const QModelIndex& index);
 
 	Model* model_;
+	Journal* journal_;
+	bool journalFailureShown;
 	Ui::TestView* ui;
 
 	Gap* chosenGap;
-	Choice* chosenChoice;
 
 	FlowLayout* textLayout;
-	FlowLayout* choiceLayout;
+	ChoiceModel* choiceModel;
 	QSet<QLabel*> words;
 	QSet<Gap*> gaps;
-	QSet<Choice*> choices;
 
-	QVector<QPair<QPushButton*, Model::Task>> buttons;
+	TaskModel* taskModel;
+
+	// Built in the background, ready once the builder is joined.
+	SearchIndex* searchIndex_;
+	std::thread searchIndexBuilder;
 };
 
 } // namespace gui
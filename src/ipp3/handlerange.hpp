@@ -0,0 +1,104 @@
+#ifndef IPP3_HANDLERANGE_HPP
+#define IPP3_HANDLERANGE_HPP
+
+namespace ipp3 {
+
+/**
+ * Iterates consecutive indices.
+ */
+class IndexIterator
+{
+public:
+	IndexIterator(int index) : index(index) {}
+
+	int operator*() const {
+		return index;
+	}
+
+	IndexIterator& operator++() {
+		++index;
+		return *this;
+	}
+
+	bool operator==(const IndexIterator& it) const {
+		return index == it.index;
+	}
+
+	bool operator!=(const IndexIterator& it) const {
+		return index != it.index;
+	}
+
+private:
+	int index;
+};
+
+/**
+ * Handles made on the fly from a sequence of indices.
+ *
+ * @details
+ * The range refers to its owner and allocates nothing, it is meant for
+ * read-only traversals with range-based for. Changes of the owner that
+ * change the sequence invalidate the range.
+ */
+template <typename Handle, typename Iterator, typename Owner>
+class HandleRange
+{
+public:
+	class const_iterator
+	{
+	public:
+		const_iterator(const Owner* owner, Iterator it) : owner(owner), it(it) {}
+
+		Handle operator*() const {
+			return HandleRange::make(owner, *it);
+		}
+
+		const_iterator& operator++() {
+			++it;
+			return *this;
+		}
+
+		bool operator==(const const_iterator& other) const {
+			return it == other.it;
+		}
+
+		bool operator!=(const const_iterator& other) const {
+			return it != other.it;
+		}
+
+	private:
+		const Owner* owner;
+		Iterator it;
+	};
+
+	HandleRange(const Owner* owner, Iterator begin, Iterator end) :
+		owner(owner), begin_(begin), end_(end) {}
+
+	const_iterator begin() const {
+		return const_iterator(owner, begin_);
+	}
+
+	const_iterator end() const {
+		return const_iterator(owner, end_);
+	}
+
+	bool isEmpty() const {
+		return begin_ == end_;
+	}
+
+private:
+	// Handles befriend the range, so that it can use their private
+	// constructors.
+	template <typename Index>
+	static Handle make(const Owner* owner, const Index& index) {
+		return Handle(owner, index);
+	}
+
+	const Owner* owner;
+	Iterator begin_;
+	Iterator end_;
+};
+
+} // namespace ipp3
+
+#endif // IPP3_HANDLERANGE_HPP
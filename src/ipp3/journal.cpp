@@ -0,0 +1,355 @@
+#include "journal.hpp"
+#include "model.hpp"
+
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDir>
+#include <QtCore/QFileInfo>
+#include <QtCore/QSaveFile>
+#include <QtCore/QStandardPaths>
+#include <QtCore/QtEndian>
+#include <QtCore/QDebug>
+
+#include <chrono>
+#include <cstring>
+
+#if defined(Q_OS_UNIX)
+#include <unistd.h>
+#elif defined(Q_OS_WIN)
+#include <io.h>
+#endif
+
+namespace ipp3 {
+
+static const char snapshotMagic[] = "LTFS";
+static const char journalMagic[] = "LTFJ";
+static const quint32 formatVersion = 2;
+
+static void syncToDisk(QFile* file)
+{
+	file->flush();
+#if defined(Q_OS_UNIX)
+	::fsync(file->handle());
+#elif defined(Q_OS_WIN)
+	::_commit(file->handle());
+#endif
+}
+
+Journal::Journal(const QString& basePath) :
+	snapshotPath(basePath + ".snapshot"),
+	journalPath(basePath + ".journal"),
+	model(nullptr),
+	generation(0),
+	recordsSinceSnapshot(0),
+	pendingGeneration(0),
+	stopping(false),
+	snapshotFailed(false),
+	failing(false)
+{
+	writer = std::thread(&Journal::writerLoop, this);
+}
+
+Journal::~Journal()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wakeUp.notify_one();
+	writer.join();
+}
+
+QString Journal::pathFor(const QString& testFile)
+{
+	QDir dir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation));
+	dir.mkpath("journals");
+
+	QByteArray path = QFileInfo(testFile).absoluteFilePath().toUtf8();
+	QByteArray name = QCryptographicHash::hash(path, QCryptographicHash::Sha1).toHex();
+	return dir.filePath("journals/" + QString::fromLatin1(name));
+}
+
+bool Journal::resume(Model* model)
+{
+	QFile snapshotFile(snapshotPath);
+	if (!snapshotFile.open(QFile::ReadOnly))
+		return false;
+
+	// Snapshot layout: header, content hash of the bank, model state.
+	QByteArray snapshot = snapshotFile.readAll();
+	QByteArray contentHash = model->bank()->contentHash();
+	quint64 snapshotGeneration;
+	if (!readHeader(snapshot, snapshotMagic, &snapshotGeneration)) {
+		qWarning() << "Ignoring an invalid snapshot" << snapshotPath;
+		return false;
+	}
+	if (snapshot.mid(headerSize, contentHash.size()) != contentHash) {
+		qWarning() << "Ignoring snapshot" << snapshotPath << "of different tasks";
+		return false;
+	}
+	if (!model->restoreState(snapshot.mid(headerSize + contentHash.size()))) {
+		qWarning() << "Ignoring an invalid snapshot" << snapshotPath;
+		return false;
+	}
+	generation = snapshotGeneration;
+
+	// Replay the tail. The journal is older than the snapshot if we crashed
+	// right after writing the snapshot, its records are already included.
+	QFile journalFile(journalPath);
+	if (!journalFile.open(QFile::ReadOnly))
+		return true;
+
+	QByteArray journal = journalFile.readAll();
+	quint64 journalGeneration;
+	if (!readHeader(journal, journalMagic, &journalGeneration) || journalGeneration != generation)
+		return true;
+
+	for (int pos = headerSize; pos + recordSize <= journal.size(); pos += recordSize) {
+		Record record;
+		if (!decode(journal.constData() + pos, &record) || !apply(model, record)) {
+			qWarning() << "Journal" << journalPath << "is damaged at offset" << pos;
+			break;
+		}
+	}
+
+	return true;
+}
+
+void Journal::attach(Model* model)
+{
+	this->model = model;
+	model->setJournal(this);
+	snapshot();
+}
+
+void Journal::record(Op op, int a, int b)
+{
+	char data[recordSize];
+	encode(Record {quint8(op), a, b}, data);
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		pendingRecords.append(data, recordSize);
+	}
+	wakeUp.notify_one();
+
+	// A failed snapshot is retried right away, not snapshotInterval
+	// records later, since nothing is saved until one succeeds.
+	if (++recordsSinceSnapshot >= snapshotInterval || snapshotFailed.exchange(false)) {
+		snapshot();
+	}
+}
+
+bool Journal::isFailing() const
+{
+	return failing;
+}
+
+QByteArray Journal::header(const char* magic, quint64 generation)
+{
+	char data[headerSize];
+	memcpy(data, magic, 4);
+	qToLittleEndian(formatVersion, reinterpret_cast<uchar*>(data + 4));
+	qToLittleEndian(generation, reinterpret_cast<uchar*>(data + 8));
+	return QByteArray(data, headerSize);
+}
+
+bool Journal::readHeader(const QByteArray& data, const char* magic, quint64* generation)
+{
+	if (data.size() < headerSize || memcmp(data.constData(), magic, 4) != 0)
+		return false;
+
+	const uchar* bytes = reinterpret_cast<const uchar*>(data.constData());
+	if (qFromLittleEndian<quint32>(bytes + 4) != formatVersion)
+		return false;
+
+	*generation = qFromLittleEndian<quint64>(bytes + 8);
+	return true;
+}
+
+// Record layout: op, zero, checksum (16 bits), a (32 bits), b (32 bits).
+// The checksum covers all the other bytes.
+
+void Journal::encode(const Record& record, char* out)
+{
+	uchar* bytes = reinterpret_cast<uchar*>(out);
+	bytes[0] = record.op;
+	bytes[1] = 0;
+	qToLittleEndian(quint16(0), bytes + 2);
+	qToLittleEndian(quint32(record.a), bytes + 4);
+	qToLittleEndian(quint32(record.b), bytes + 8);
+	qToLittleEndian(qChecksum(out, recordSize), bytes + 2);
+}
+
+bool Journal::decode(const char* in, Record* record)
+{
+	char data[recordSize];
+	memcpy(data, in, recordSize);
+
+	const uchar* bytes = reinterpret_cast<const uchar*>(in);
+	quint16 checksum = qFromLittleEndian<quint16>(bytes + 2);
+	data[2] = data[3] = 0;
+	if (qChecksum(data, recordSize) != checksum || bytes[1] != 0)
+		return false;
+
+	record->op = bytes[0];
+	record->a = qint32(qFromLittleEndian<quint32>(bytes + 4));
+	record->b = qint32(qFromLittleEndian<quint32>(bytes + 8));
+	return true;
+}
+
+bool Journal::apply(Model* model, const Record& record)
+{
+	// Records are checked against the model like user actions would be,
+	// anything inconsistent means the journal does not belong here.
+	auto isGap = [=] (int i) { return i >= 0 && i < model->totalGaps(); };
+	auto isTask = [=] (int i) { return i >= 0 && i < model->tasksCount(); };
+	int current = model->currentTask().index();
+
+	switch (Op(record.op)) {
+		case Op::Insert: {
+			if (record.a < 0 || record.a >= model->phrasesCount() || !isGap(record.b))
+				return false;
+			Model::Phrase phrase = model->phrase(record.a);
+			Model::Gap gap = model->gap(record.b);
+			if (!phrase.isInChoices() || !gap.isEmpty() || phrase.task() != gap.task()
+				|| gap.task().isFinished())
+				return false;
+			model->insert(phrase, gap);
+			return true;
+		}
+
+		case Op::Remove: {
+			if (!isGap(record.a))
+				return false;
+			Model::Gap gap = model->gap(record.a);
+			if (gap.isEmpty() || gap.task().isFinished() || record.b < 0
+				|| record.b > gap.task().choicesCount())
+				return false;
+			model->remove(gap, record.b);
+			return true;
+		}
+
+		case Op::Swap: {
+			if (!isGap(record.a) || !isGap(record.b))
+				return false;
+			Model::Gap a = model->gap(record.a);
+			Model::Gap b = model->gap(record.b);
+			if (a.task() != b.task() || a.task().isFinished())
+				return false;
+			model->swap(a, b);
+			return true;
+		}
+
+		case Op::Finish:
+			if (record.a != current)
+				return false;
+			model->finish();
+			return true;
+
+		case Op::Reset:
+			if (record.a != current)
+				return false;
+			model->reset();
+			return true;
+
+		case Op::Switch:
+			if (!isTask(record.a))
+				return false;
+			model->switchTask(model->task(record.a));
+			return true;
+	}
+
+	return false;
+}
+
+void Journal::snapshot()
+{
+	Q_ASSERT(model);
+
+	QByteArray state = model->bank()->contentHash() + model->saveState();
+	generation++;
+	recordsSinceSnapshot = 0;
+
+	{
+		// Pending records are part of the snapshot.
+		std::lock_guard<std::mutex> lock(mutex);
+		pendingSnapshot = state;
+		pendingGeneration = generation;
+		pendingRecords.clear();
+	}
+	wakeUp.notify_one();
+}
+
+void Journal::writerLoop()
+{
+	QFile journal(journalPath);
+
+	for (;;) {
+		std::unique_lock<std::mutex> lock(mutex);
+		wakeUp.wait(lock, [this] {
+			return stopping || !pendingRecords.isEmpty() || !pendingSnapshot.isEmpty();
+		});
+
+		// Let more records arrive so that they are synced together.
+		wakeUp.wait_for(lock, std::chrono::milliseconds(batchDelayMs), [this] { return stopping; });
+
+		QByteArray snapshot, records;
+		snapshot.swap(pendingSnapshot);
+		records.swap(pendingRecords);
+		quint64 snapshotGeneration = pendingGeneration;
+		bool stop = stopping;
+		lock.unlock();
+
+		if (!snapshot.isEmpty()) {
+			writeSnapshot(&journal, snapshotGeneration, snapshot);
+		}
+		if (!records.isEmpty()) {
+			writeRecords(&journal, records);
+		}
+		if (stop) {
+			return;
+		}
+	}
+}
+
+void Journal::writeSnapshot(QFile* journal, quint64 generation, const QByteArray& state)
+{
+	// The old journal does not follow the records dropped for this
+	// snapshot, so it is not appended to whatever happens.
+	journal->close();
+
+	// QSaveFile replaces the old snapshot atomically on commit.
+	QSaveFile file(snapshotPath);
+	if (!file.open(QFile::WriteOnly) || file.write(header(snapshotMagic, generation) + state) < 0
+		|| !file.commit()) {
+		qWarning() << "Cannot write snapshot" << snapshotPath << file.errorString()
+				   << "- changes are not recorded until the next snapshot";
+		failing = true;
+		snapshotFailed = true;
+		return;
+	}
+
+	// Only now the old journal can go, until then it is still needed.
+	if (!journal->open(QFile::WriteOnly | QFile::Truncate)) {
+		qWarning() << "Cannot open journal" << journalPath << journal->errorString()
+				   << "- changes are not recorded until the next snapshot";
+		failing = true;
+		snapshotFailed = true;
+		return;
+	}
+	failing = false;
+	journal->write(header(journalMagic, generation));
+	syncToDisk(journal);
+}
+
+void Journal::writeRecords(QFile* journal, const QByteArray& records)
+{
+	// Already warned about in writeSnapshot().
+	if (!journal->isOpen())
+		return;
+
+	journal->write(records);
+	syncToDisk(journal);
+}
+
+} // namespace ipp3
@@ -0,0 +1,138 @@
+#ifndef IPP3_JOURNAL_HPP
+#define IPP3_JOURNAL_HPP
+
+#include <QtCore/QByteArray>
+#include <QtCore/QString>
+#include <QtCore/QFile>
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace ipp3 {
+
+class Model;
+
+/**
+ * Crash-safe record of the answers given in a model.
+ *
+ * @details
+ * Every change of the model is appended to a journal file as a small
+ * fixed-size record. Records are written by a background thread which
+ * batches them and syncs the file once per batch, so the GUI thread only
+ * appends to a memory buffer. Every snapshotInterval records the whole
+ * answer state is written to a snapshot file (atomically replaced) and
+ * the journal starts over, so resuming replays at most that many records.
+ *
+ * Both files carry a generation number. A journal is replayed only on
+ * top of the snapshot of the same generation, a journal that is older
+ * than the snapshot (crash right after a snapshot) is ignored. A torn
+ * record at the end of the journal is detected by its checksum and
+ * dropped together with everything after it. The snapshot also holds the
+ * content hash of the bank, so answers are never resumed on a test file
+ * that has changed since.
+ *
+ * If a snapshot cannot be written, nothing is recorded until a snapshot
+ * succeeds. It is retried with the next change, and isFailing() tells
+ * whether the answers are being saved.
+ */
+class Journal
+{
+public:
+	enum class Op : quint8
+	{
+		Insert,
+		Remove,
+		Swap,
+		Finish,
+		Reset,
+		Switch
+	};
+
+	static const int snapshotInterval = 4096;
+	static const int batchDelayMs = 200;
+
+	/**
+	 * Uses files @a basePath + ".snapshot" and @a basePath + ".journal".
+	 */
+	Journal(const QString& basePath);
+
+	/**
+	 * Writes all pending records and stops the writer thread.
+	 */
+	~Journal();
+
+	/**
+	 * Default location of the journal for a test file.
+	 */
+	static QString pathFor(const QString& testFile);
+
+	/**
+	 * Brings @a model to the last recorded state (snapshot and journal
+	 * tail). Returns false if there was nothing (valid) to resume.
+	 */
+	bool resume(Model* model);
+
+	/**
+	 * Starts recording changes of @a model. Writes a fresh snapshot first.
+	 */
+	void attach(Model* model);
+
+	/**
+	 * Appends a record. Called by the model after each change.
+	 */
+	void record(Op op, int a, int b = 0);
+
+	/**
+	 * Whether the last snapshot could not be written, so changes are not
+	 * being saved.
+	 */
+	bool isFailing() const;
+
+private:
+	struct Record {
+		quint8 op;
+		qint32 a;
+		qint32 b;
+	};
+
+	static const int recordSize = 12;
+	static const int headerSize = 16;
+
+	static QByteArray header(const char* magic, quint64 generation);
+	static bool readHeader(const QByteArray& data, const char* magic, quint64* generation);
+	static void encode(const Record& record, char* out);
+	static bool decode(const char* in, Record* record);
+	static bool apply(Model* model, const Record& record);
+
+	void snapshot();
+	void writerLoop();
+	void writeSnapshot(QFile* journal, quint64 generation, const QByteArray& state);
+	void writeRecords(QFile* journal, const QByteArray& records);
+
+	QString snapshotPath;
+	QString journalPath;
+
+	Model* model;
+	quint64 generation;
+	int recordsSinceSnapshot;
+
+	// Shared with the writer thread.
+	std::mutex mutex;
+	std::condition_variable wakeUp;
+	QByteArray pendingRecords;
+	QByteArray pendingSnapshot;
+	quint64 pendingGeneration;
+	bool stopping;
+	std::thread writer;
+
+	// Set by the writer thread. snapshotFailed asks record() to retry,
+	// failing stays set until a snapshot succeeds.
+	std::atomic<bool> snapshotFailed;
+	std::atomic<bool> failing;
+};
+
+} // namespace ipp3
+
+#endif // IPP3_JOURNAL_HPP
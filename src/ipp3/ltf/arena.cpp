@@ -0,0 +1,47 @@
+#include "arena.hpp"
+
+#include <cstdint>
+
+namespace ipp3 {
+namespace ltf {
+
+Arena::Arena() :
+	next(nullptr),
+	left(0),
+	capacity_(0)
+{
+}
+
+Arena::~Arena()
+{
+	for (char* chunk : chunks) {
+		delete[] chunk;
+	}
+}
+
+void* Arena::allocate(size_t size, size_t alignment)
+{
+	size_t padding = (alignment - reinterpret_cast<uintptr_t>(next) % alignment) % alignment;
+	if (padding + size > left) {
+		// Oversized requests get a chunk of their own.
+		size_t chunk = qMax(size + alignment, chunkSize);
+		chunks.push_back(new char[chunk]);
+		capacity_ += chunk;
+		next = chunks.back();
+		left = chunk;
+		padding = (alignment - reinterpret_cast<uintptr_t>(next) % alignment) % alignment;
+	}
+
+	void* result = next + padding;
+	next += padding + size;
+	left -= padding + size;
+	return result;
+}
+
+qint64 Arena::capacity() const
+{
+	return capacity_;
+}
+
+} // namespace ltf
+} // namespace ipp3
@@ -0,0 +1,64 @@
+#ifndef IPP3_LTF_ARENA_HPP
+#define IPP3_LTF_ARENA_HPP
+
+#include <QtCore/QtGlobal>
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace ipp3 {
+namespace ltf {
+
+/**
+ * Monotonic allocator for a parse tree.
+ *
+ * @details
+ * Memory is handed out from large chunks by bumping a pointer and is never
+ * freed individually, everything goes at once when the arena is destroyed.
+ * Destructors of the objects are never run, so they must not own anything
+ * outside of the arena.
+ */
+class Arena
+{
+public:
+	static const size_t chunkSize = 64 * 1024;
+
+	Arena();
+	~Arena();
+
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+
+	void* allocate(size_t size, size_t alignment);
+
+	/**
+	 * Copies @a count objects to the arena.
+	 */
+	template <typename T>
+	T* copy(const T* data, int count) {
+		if (count == 0)
+			return nullptr;
+		T* result = static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+		for (int i = 0; i < count; ++i) {
+			new(result + i) T(data[i]);
+		}
+		return result;
+	}
+
+	/**
+	 * Bytes taken from the system.
+	 */
+	qint64 capacity() const;
+
+private:
+	std::vector<char*> chunks;
+	char* next;
+	size_t left;
+	qint64 capacity_;
+};
+
+} // namespace ltf
+} // namespace ipp3
+
+#endif // IPP3_LTF_ARENA_HPP
@@ -3,24 +3,94 @@
 
 #include <QtCore/QString>
 #include <QtCore/QVector>
+#include <QtCore/QSharedPointer>
 
+#include "arena.hpp"
 #include "../either.hpp"
 
 namespace ipp3 {
 namespace ltf {
 
+/**
+ * A string stored in the arena of a document.
+ */
+struct Text {
+	const QChar* data;
+	int size;
+
+	bool isEmpty() const {
+		return size == 0;
+	}
+
+	/**
+	 * A copy that outlives the document.
+	 */
+	QString toString() const {
+		return QString(data, size);
+	}
+
+	/**
+	 * A QString using the arena data without copying it, valid only as
+	 * long as the document.
+	 */
+	QString rawString() const {
+		return QString::fromRawData(data, size);
+	}
+};
+
+/**
+ * An array stored in the arena of a document.
+ */
+template <typename T>
+struct Span {
+	const T* data;
+	int size;
+
+	const T* begin() const {
+		return data;
+	}
+
+	const T* end() const {
+		return data + size;
+	}
+
+	const T& operator[](int i) const {
+		return data[i];
+	}
+};
+
 struct Gap {
-	QString img;
-	QString content;
+	Text img;
+	Text content;
 };
 
 struct Task {
-	QVector<Either<QString, Gap>> content;
-	QVector<QString> extra;
+	Span<Either<Text, Gap>> content;
+	Span<Text> extra;
 };
 
+/**
+ * A parsed LTF file.
+ *
+ * @details
+ * Everything but the task list lives in arenas, which are released in one
+ * go with the last document referring to them.
+ */
 struct Document {
 	QVector<Task> tasks;
+	QVector<QSharedPointer<const Arena>> arenas;
+
+	/**
+	 * Appends task @a index of @a other, keeping its arena alive.
+	 */
+	void appendTask(const Document& other, int index) {
+		tasks.append(other.tasks[index]);
+		for (const QSharedPointer<const Arena>& arena : other.arenas) {
+			if (!arenas.contains(arena)) {
+				arenas.append(arena);
+			}
+		}
+	}
 };
 
 } // namespace ltf
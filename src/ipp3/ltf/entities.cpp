@@ -0,0 +1,108 @@
+#include "entities.hpp"
+
+#include <cstring>
+
+namespace ipp3 {
+namespace ltf {
+
+namespace {
+
+struct EntityRecord {
+	quint16 name;
+	quint8 nameLength;
+	quint16 value;
+	quint8 valueLength;
+};
+
+#include "entitytable.inc"
+
+} // namespace
+
+static_assert(maxEntityNameLength <= maxEntityLength, "Named entities must fit in maxEntityLength.");
+
+/**
+ * FNV-1a with a seeded basis and a final mix, as in tools/entities.py.
+ */
+static quint32 entityHash(const char* name, int length, quint32 seed)
+{
+	quint32 h = 2166136261u ^ seed;
+	for (int i = 0; i < length; ++i) {
+		h ^= uchar(name[i]);
+		h *= 16777619u;
+	}
+	h ^= h >> 16;
+	h *= 0x85EBCA6Bu;
+	h ^= h >> 13;
+	h *= 0xC2B2AE35u;
+	h ^= h >> 16;
+	return h;
+}
+
+static bool decodeNamed(const char* name, int length, QString* out)
+{
+	if (length > maxEntityNameLength)
+		return false;
+
+	quint32 seed = entitySeeds[entityHash(name, length, 0) % entityBucketCount];
+	quint16 index = entitySlots[entityHash(name, length, seed) & (entitySlotCount - 1)];
+	if (index == noEntity)
+		return false;
+
+	const EntityRecord& record = entityRecords[index];
+	if (record.nameLength != length || memcmp(entityNames + record.name, name, length) != 0)
+		return false;
+
+	out->append(reinterpret_cast<const QChar*>(entityValues + record.value), record.valueLength);
+	return true;
+}
+
+static bool decodeNumeric(const char* digits, int length, QString* out)
+{
+	int base = 10;
+	if (length > 0 && (digits[0] == 'x' || digits[0] == 'X')) {
+		base = 16;
+		++digits;
+		--length;
+	}
+	if (length == 0)
+		return false;
+
+	uint code = 0;
+	for (int i = 0; i < length; ++i) {
+		char c = digits[i];
+		uint digit;
+		if (c >= '0' && c <= '9') {
+			digit = c - '0';
+		} else if (base == 16 && c >= 'a' && c <= 'f') {
+			digit = c - 'a' + 10;
+		} else if (base == 16 && c >= 'A' && c <= 'F') {
+			digit = c - 'A' + 10;
+		} else {
+			return false;
+		}
+		code = code * base + digit;
+		if (code > 0x10FFFF)
+			return false;
+	}
+
+	if (code == 0 || QChar::isSurrogate(code))
+		return false;
+
+	if (QChar::requiresSurrogates(code)) {
+		out->append(QChar(QChar::highSurrogate(code)));
+		out->append(QChar(QChar::lowSurrogate(code)));
+	} else {
+		out->append(QChar(code));
+	}
+	return true;
+}
+
+bool decodeEntity(const char* name, int length, QString* out)
+{
+	if (length > 0 && name[0] == '#')
+		return decodeNumeric(name + 1, length - 1, out);
+	return decodeNamed(name, length, out);
+}
+
+} // namespace ltf
+} // namespace ipp3
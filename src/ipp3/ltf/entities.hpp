@@ -0,0 +1,30 @@
+#ifndef IPP3_LTF_ENTITIES_HPP
+#define IPP3_LTF_ENTITIES_HPP
+
+#include <QtCore/QString>
+
+namespace ipp3 {
+namespace ltf {
+
+/**
+ * The longest entity name decodeEntity() may accept.
+ */
+static const int maxEntityLength = 32;
+
+/**
+ * Appends the characters of the entity @a name (what is between '&' and
+ * ';') to @a out. Named entities are the HTML5 ones, numeric ones are
+ * "#" followed by a decimal or "#x" by a hexadecimal code point. Returns
+ * false, appending nothing, if there is no such entity.
+ *
+ * @details
+ * Named entities are looked up in a perfect hash table generated by
+ * tools/entities.py, so a lookup hashes the name twice and compares it
+ * once.
+ */
+bool decodeEntity(const char* name, int length, QString* out);
+
+} // namespace ltf
+} // namespace ipp3
+
+#endif // IPP3_LTF_ENTITIES_HPP
@@ -1,4 +1,5 @@
 #include "parser.hpp"
+#include "../trace.hpp"
 
 namespace ipp3 {
 namespace ltf {
@@ -13,44 +14,118 @@ QString ParserError::message() const
 	return message_;
 }
 
+Parser::Parser() :
+	pipelined(false),
+	tokenizer(nullptr),
+	pipeline(nullptr),
+	arena(nullptr)
+{
+}
+
+void Parser::setPipelined(bool pipelined)
+{
+	this->pipelined = pipelined;
+}
+
+void Parser::setArena(const QSharedPointer<Arena>& arena)
+{
+	sharedArena = arena;
+}
+
 Document Parser::parse(QTextStream* stream)
 {
-	// All parsing happens in the scope of this function, so the tokenizer pointer will be valid.
-	Tokenizer tok(stream);
-	tokenizer = &tok;
+	std::unique_ptr<Tokenizer> tok;
+	std::unique_ptr<TokenPipeline> pipe;
+	if (pipelined) {
+		pipe.reset(new TokenPipeline(stream));
+	} else {
+		tok.reset(new Tokenizer(stream));
+	}
+	return parseTokens(tok.get(), pipe.get(), nullptr);
+}
 
-	input.reset([&tok] (Token* token) -> bool {
-		if (tok.status() == Tokenizer::Status::Available) {
-			(*token) = tok.read();
-			return true;
-		} else {
-			return false;
-		}
-	});
+Document Parser::parse(const QByteArray& utf8)
+{
+	std::unique_ptr<Tokenizer> tok;
+	std::unique_ptr<TokenPipeline> pipe;
+	if (pipelined) {
+		pipe.reset(new TokenPipeline(utf8));
+	} else {
+		tok.reset(new Tokenizer(utf8));
+	}
+	return parseTokens(tok.get(), pipe.get(), nullptr);
+}
+
+Document Parser::parse(const QVector<Token>& tokens)
+{
+	return parseTokens(nullptr, nullptr, &tokens);
+}
 
-	return document();
+Document Parser::parseTokens(Tokenizer* tokenizer, TokenPipeline* pipeline, const QVector<Token>* given)
+{
+	TraceSpan span("Parser::parse", "load");
+
+	// All parsing happens in the scope of this function, so the tokenizer,
+	// pipeline and given tokens pointers will be valid.
+	this->tokenizer = tokenizer;
+	this->pipeline = pipeline;
+
+	// When tracing, the time spent getting tokens is reported as an
+	// argument of the parse span: the tokenizer time when it runs
+	// interleaved with the parser, the time spent waiting for it when
+	// pipelined.
+	const bool timed = Trace::isEnabled();
+	qint64 tokens = 0;
+	qint64 tokenizerTime = 0;
+
+	const Token* givenBegin = given ? given->constData() : nullptr;
+	const Token* givenEnd = given ? givenBegin + given->size() : nullptr;
+	input.reset(TokenSource {tokenizer, pipeline, givenBegin, givenEnd, timed, &tokens, &tokenizerTime});
+
+	// Released with the last copy of the document.
+	QSharedPointer<Arena> documentArena = sharedArena ? sharedArena : QSharedPointer<Arena>(new Arena());
+	arena = documentArena.data();
+
+	Document doc = document();
+	doc.arenas.append(documentArena);
+	span.setArg("tokens", tokens);
+	span.setArg("tokenizerUs", tokenizerTime / 1000);
+	return doc;
 }
 
-QString Parser::expect(Token::Type tokenType)
+void Parser::expect(Token::Type tokenType)
 {
-	Token token = getToken();
+	const Token& token = peekToken();
 	if (token.type != tokenType) {
 		throw ParserError("Expected a " + Token(tokenType).toString() 
 			+ " token, got " + token.toString() + " instead.");
 	}
-	return token.data;
+	input.skip();
 }
 
-void Parser::expectIdentifier(const QString& identifier)
+void Parser::expectIdentifier(const char* identifier)
 {
-	Token token = getToken();
+	const Token& token = peekToken();
 	if (token.type != Token::Identifier) {
-		throw ParserError("Expected an identifier (\"" + identifier + "\"), got " 
+		throw ParserError("Expected an identifier (\"" + QLatin1String(identifier) + "\"), got " 
 			+ token.toString() + " instead.");
 	}
-	if (token.data != identifier) {
-		throw ParserError("Expected a \"" + identifier + "\", got \"" + token.data + "\" instead.");
+	if (token.data != QLatin1String(identifier)) {
+		throw ParserError("Expected a \"" + QLatin1String(identifier) + "\", got \"" + token.data + "\" instead.");
 	}
+	input.skip();
+}
+
+Text Parser::expectText(Token::Type tokenType)
+{
+	const Token& token = peekToken();
+	if (token.type != tokenType) {
+		throw ParserError("Expected a " + Token(tokenType).toString() 
+			+ " token, got " + token.toString() + " instead.");
+	}
+	Text result = text(token.data);
+	input.skip();
+	return result;
 }
 
 Document Parser::document()
@@ -58,17 +133,20 @@ Document Parser::document()
 	Document doc;
 
 	for (;;) {
-		Token token = getToken();
+		const Token& token = peekToken();
 		switch (token.type) {
 			case Token::TagStart:
+				input.skip();
 				doc.tasks.append(task());
 				break;
 
 			case Token::Text:
 				// Ignore the text.
+				input.skip();
 				break;
 
 			case Token::EndOfFile:
+				input.skip();
 				return doc;
 
 			default:
@@ -79,63 +157,66 @@ Document Parser::document()
 
 Task Parser::task()
 {
-	Task task;
-
 	// Opening tag.
 	expectIdentifier("task");
-	auto attribs = attributes();
+	attributes(nullptr);
 	expect(Token::TagEnd);
 
-	// Tag content.
-	taskContent(task);
+	// Tag content, collected first since its size is not known yet.
+	content.clear();
+	extras.clear();
+	taskContent();
 
 	// Closing tag.
 	expect(Token::ClosingTagStart);
 	expectIdentifier("task");
 	expect(Token::TagEnd);
 
+	Task task;
+	task.content = {arena->copy(content.constData(), content.size()), content.size()};
+	task.extra = {arena->copy(extras.constData(), extras.size()), extras.size()};
 	return task;
 }
 
-void Parser::taskContent(Task& task)
-{
-	Token token = peekToken();
-	switch (token.type) {
-		case Token::TagStart: {
-			input.skip();
-			// Parse a gap or an extra.
-			token = peekToken();
-			if (token.type != Token::Identifier)
-				throw ParserError("Expected an identifier after '<', got " + token.toString() + " instead.");
-			if (token.data == "gap") {
-				task.content.append(gap());
-			} else if (token.data == "extra") {
-				task.extra.append(extra());
-			} else {
-				throw ParserError("Expected an 'extra' or 'gap' tag, but got '" + token.data + "'.");
+void Parser::taskContent()
+{
+	for (;;) {
+		const Token& token = peekToken();
+		switch (token.type) {
+			case Token::TagStart: {
+				// Parse a gap or an extra, told apart by the tag name.
+				const Token& name = peekToken(1);
+				if (name.type != Token::Identifier)
+					throw ParserError("Expected an identifier after '<', got " + name.toString() + " instead.");
+				if (name.data == QLatin1String("gap")) {
+					input.skip();
+					content.append(gap());
+				} else if (name.data == QLatin1String("extra")) {
+					input.skip();
+					extras.append(extra());
+				} else {
+					throw ParserError("Expected an 'extra' or 'gap' tag, but got '" + name.data + "'.");
+				}
+				break;
 			}
-			break;
-		}
 
-		case Token::Text:
-			input.skip();
-			task.content.append(token.data);
-			break;
+			case Token::Text:
+				content.append(expectText(Token::Text));
+				break;
 
-		default:
-			return;
+			default:
+				return;
+		}
 	}
-
-	return taskContent(task);
 }
 
-QString Parser::extra()
+Text Parser::extra()
 {
 	expectIdentifier("extra");
-	auto attribs = attributes();
+	attributes(nullptr);
 	expect(Token::TagEnd);
 
-	QString content = expect(Token::Text);
+	Text content = expectText(Token::Text);
 
 	expect(Token::ClosingTagStart);
 	expectIdentifier("extra");
@@ -147,13 +228,14 @@ QString Parser::extra()
 Gap Parser::gap()
 {
 	Gap gap;
+	// The img attribute is optional.
+	gap.img = Text {nullptr, 0};
 
 	expectIdentifier("gap");
-	auto attribs = attributes();
-	gap.img = attribs.value("img");
+	attributes(&gap.img);
 	expect(Token::TagEnd);
 
-	gap.content = expect(Token::Text);
+	gap.content = expectText(Token::Text);
 
 	expect(Token::ClosingTagStart);
 	expectIdentifier("gap");
@@ -162,46 +244,65 @@ Gap Parser::gap()
 	return gap;
 }
 
-QPair<QString, QString> Parser::attribute()
+Text Parser::text(const QString& string)
 {
-	QString id = expect(Token::Identifier);
-	expect(Token::Equals);
-	QString val = expect(Token::Quoted);
-	return qMakePair(id, val);
+	return Text {arena->copy(string.constData(), string.size()), string.size()};
 }
 
-QMap<QString, QString> Parser::attributes()
+void Parser::attributes(Text* img)
 {
-	QMap<QString, QString> attribs;
-
 	while (peekToken().type == Token::Identifier) {
-		auto att = attribute();
-		attribs.insert(att.first, att.second);
+		bool isImg = img && peekToken().data == QLatin1String("img");
+		input.skip();
+		expect(Token::Equals);
+		if (isImg) {
+			*img = expectText(Token::Quoted);
+		} else {
+			expect(Token::Quoted);
+		}
 	}
-
-	return attribs;
 }
 
-Token Parser::getToken()
+bool Parser::TokenSource::operator()(Token* token)
 {
-	Token token;
-	if (input.get(&token)) {
-		return token;
+	qint64 start = timed ? Trace::now() : 0;
+	if (given) {
+		if (given == givenEnd)
+			return false;
+		(*token) = *given++;
+	} else if (pipeline) {
+		if (!pipeline->read(token))
+			return false;
 	} else {
-		// Propagate tokenizer error.
-		throw ParserError{tokenizer->errorMessage()};
+		if (tokenizer->status() != Tokenizer::Status::Available)
+			return false;
+		(*token) = tokenizer->read();
+	}
+
+	if (timed) {
+		(*tokenizerTime) += Trace::now() - start;
 	}
+	(*tokens)++;
+	return true;
 }
 
-Token Parser::peekToken()
+const Token& Parser::peekToken(int n)
 {
-	Token token;
-	if (input.peek(&token)) {
-		return token;
-	} else {
+	const Token* token = input.peekAt(n);
+	if (!token) {
 		// Propagate tokenizer error.
-		throw ParserError{tokenizer->errorMessage()};
+		throw ParserError{tokenizerError()};
 	}
+	return *token;
+}
+
+QString Parser::tokenizerError() const
+{
+	if (pipeline)
+		return pipeline->errorMessage();
+	if (tokenizer)
+		return tokenizer->errorMessage();
+	return "Unexpected end of input.";
 }
 
 } // namespace ltf
@@ -3,6 +3,7 @@
 
 #include "document.hpp"
 #include "tokenizer.hpp"
+#include "tokenpipeline.hpp"
 
 #include <memory>
 #include <QtCore/QTextStream>
@@ -28,28 +29,99 @@ private:
 class Parser
 {
 public:
+	Parser();
+
 	/**
 	 * Parses a document from a stream. May throw a ParserError.
 	 */
 	Document parse(QTextStream *stream);
 
+	/**
+	 * Parses a document from UTF-8 text, which is tokenized without
+	 * decoding all of it first. May throw a ParserError.
+	 */
+	Document parse(const QByteArray& utf8);
+
+	/**
+	 * Parses a document from tokens read earlier, which must end with an
+	 * EndOfFile token. May throw a ParserError.
+	 */
+	Document parse(const QVector<Token>& tokens);
+
+	/**
+	 * When set, the stream is tokenized on a separate thread (see
+	 * TokenPipeline) while the document is being built. Pays off for
+	 * large files only. Off by default.
+	 */
+	void setPipelined(bool pipelined);
+
+	/**
+	 * Allocates the documents parsed from now on in @a arena, instead of
+	 * a new arena for each.
+	 */
+	void setArena(const QSharedPointer<Arena>& arena);
+
 private:
-	Token getToken();
-	Token peekToken();
+	/**
+	 * Reads tokens from the tokenizer, the pipeline or the given tokens,
+	 * timing it when tracing.
+	 */
+	struct TokenSource {
+		Tokenizer* tokenizer;
+		TokenPipeline* pipeline;
+		const Token* given;
+		const Token* givenEnd;
+		bool timed;
+		qint64* tokens;
+		qint64* tokenizerTime;
 
-	QString expect(Token::Type tokenType);
-	void expectIdentifier(const QString &identifier);
+		bool operator()(Token* token);
+	};
+
+	Document parseTokens(Tokenizer* tokenizer, TokenPipeline* pipeline, const QVector<Token>* given);
+
+	/**
+	 * The @a n-th next token, without consuming it. The reference is valid
+	 * until the token is consumed.
+	 */
+	const Token& peekToken(int n = 0);
+	QString tokenizerError() const;
+
+	/**
+	 * Consume the next token, which must be of the given kind. Payloads
+	 * are copied only by expectText(), straight into the arena.
+	 */
+	//@{
+	void expect(Token::Type tokenType);
+	void expectIdentifier(const char* identifier);
+	Text expectText(Token::Type tokenType);
+	//@}
 
 	Document document();
 	Task task();
-	void taskContent(Task& task);
-	QString extra();
+	void taskContent();
+	Text extra();
 	Gap gap();
-	QPair<QString, QString> attribute();
-	QMap<QString, QString> attributes();
+	Text text(const QString& string);
+
+	/**
+	 * Skips the attributes of a tag, except that the value of "img" is
+	 * stored in @a img if it is not null.
+	 */
+	void attributes(Text* img);
 
+	bool pipelined;
+	// At most one of them is set during parse().
 	Tokenizer *tokenizer;
-	PeekBuffer<Token> input;
+	TokenPipeline *pipeline;
+	PeekBuffer<Token, TokenSource> input;
+
+	// The document being parsed allocates from here.
+	Arena* arena;
+	QSharedPointer<Arena> sharedArena;
+	// Content of the current task, reused between tasks.
+	QVector<Either<Text, Gap>> content;
+	QVector<Text> extras;
 };
 
 } // namespace ltf
@@ -0,0 +1,124 @@
+#include "scan.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#define IPP3_SCAN_X86
+#include <immintrin.h>
+#endif
+
+namespace ipp3 {
+namespace ltf {
+
+template <typename Unit>
+static const Unit* findScalar(const Unit* p, const Unit* end, Unit a, Unit b)
+{
+	for (; p != end; ++p) {
+		if (*p == a || *p == b)
+			return p;
+	}
+	return end;
+}
+
+#ifdef IPP3_SCAN_X86
+
+// The byte mask of a comparison has one bit per byte, so a UTF-16 match
+// sets two bits and its index is half the bit index.
+
+static const ushort* findSse2(const ushort* p, const ushort* end, ushort a, ushort b)
+{
+	const __m128i va = _mm_set1_epi16(short(a));
+	const __m128i vb = _mm_set1_epi16(short(b));
+	for (; end - p >= 8; p += 8) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi16(v, va), _mm_cmpeq_epi16(v, vb)));
+		if (mask)
+			return p + __builtin_ctz(mask) / 2;
+	}
+	return findScalar(p, end, a, b);
+}
+
+static const char* findSse2(const char* p, const char* end, char a, char b)
+{
+	const __m128i va = _mm_set1_epi8(a);
+	const __m128i vb = _mm_set1_epi8(b);
+	for (; end - p >= 16; p += 16) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, va), _mm_cmpeq_epi8(v, vb)));
+		if (mask)
+			return p + __builtin_ctz(mask);
+	}
+	return findScalar(p, end, a, b);
+}
+
+__attribute__((target("avx2")))
+static const ushort* findAvx2(const ushort* p, const ushort* end, ushort a, ushort b)
+{
+	const __m256i va = _mm256_set1_epi16(short(a));
+	const __m256i vb = _mm256_set1_epi16(short(b));
+	for (; end - p >= 16; p += 16) {
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+		unsigned mask = unsigned(_mm256_movemask_epi8(
+			_mm256_or_si256(_mm256_cmpeq_epi16(v, va), _mm256_cmpeq_epi16(v, vb))));
+		if (mask)
+			return p + __builtin_ctz(mask) / 2;
+	}
+	return findSse2(p, end, a, b);
+}
+
+__attribute__((target("avx2")))
+static const char* findAvx2(const char* p, const char* end, char a, char b)
+{
+	const __m256i va = _mm256_set1_epi8(a);
+	const __m256i vb = _mm256_set1_epi8(b);
+	for (; end - p >= 32; p += 32) {
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+		unsigned mask = unsigned(_mm256_movemask_epi8(
+			_mm256_or_si256(_mm256_cmpeq_epi8(v, va), _mm256_cmpeq_epi8(v, vb))));
+		if (mask)
+			return p + __builtin_ctz(mask);
+	}
+	return findSse2(p, end, a, b);
+}
+
+#endif // IPP3_SCAN_X86
+
+namespace {
+
+struct Kernel {
+	const ushort* (*utf16)(const ushort*, const ushort*, ushort, ushort);
+	const char* (*utf8)(const char*, const char*, char, char);
+};
+
+Kernel pickKernel()
+{
+#ifdef IPP3_SCAN_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return Kernel {findAvx2, findAvx2};
+	return Kernel {findSse2, findSse2};
+#else
+	return Kernel {findScalar<ushort>, findScalar<char>};
+#endif
+}
+
+const Kernel& kernel()
+{
+	static const Kernel selected = pickKernel();
+	return selected;
+}
+
+} // namespace
+
+const QChar* findEither(const QChar* begin, const QChar* end, QChar a, QChar b)
+{
+	const ushort* found = kernel().utf16(reinterpret_cast<const ushort*>(begin),
+										 reinterpret_cast<const ushort*>(end), a.unicode(), b.unicode());
+	return begin + (found - reinterpret_cast<const ushort*>(begin));
+}
+
+const char* findEither(const char* begin, const char* end, char a, char b)
+{
+	return kernel().utf8(begin, end, a, b);
+}
+
+} // namespace ltf
+} // namespace ipp3
@@ -0,0 +1,25 @@
+#ifndef IPP3_LTF_SCAN_HPP
+#define IPP3_LTF_SCAN_HPP
+
+#include <QtCore/QChar>
+
+namespace ipp3 {
+namespace ltf {
+
+/**
+ * The first @a a or @a b in [@a begin, @a end), or @a end if there is none.
+ *
+ * @details
+ * Looks at many code units at a time: 32 bytes with AVX2 when the CPU has
+ * it, otherwise 16 with SSE2 on x86, or one by one elsewhere. The
+ * implementation is picked once, on first use.
+ */
+//@{
+const QChar* findEither(const QChar* begin, const QChar* end, QChar a, QChar b);
+const char* findEither(const char* begin, const char* end, char a, char b);
+//@}
+
+} // namespace ltf
+} // namespace ipp3
+
+#endif // IPP3_LTF_SCAN_HPP
@@ -0,0 +1,163 @@
+#include "streamparser.hpp"
+
+namespace ipp3 {
+namespace ltf {
+
+StreamParser::StreamParser() :
+	state(State::Start),
+	inElement(false)
+{
+	parser.setArena(QSharedPointer<Arena>(new Arena()));
+}
+
+void StreamParser::feed(const QByteArray& utf8)
+{
+	tokenizer.feed(utf8);
+	readTokens();
+}
+
+void StreamParser::finish()
+{
+	tokenizer.finish();
+	readTokens();
+}
+
+Document StreamParser::takeTasks()
+{
+	Document tasks = completed;
+	completed = Document();
+	return tasks;
+}
+
+bool StreamParser::isFinished()
+{
+	return tokenizer.status() == Tokenizer::Status::Completed;
+}
+
+void StreamParser::readTokens()
+{
+	while (tokenizer.status() == Tokenizer::Status::Available) {
+		Token token = tokenizer.read();
+
+		// Text between tasks is ignored, anything else out of place is
+		// left for the parser to report.
+		if (pending.isEmpty() && token.type == Token::Text)
+			continue;
+		if (pending.isEmpty() && token.type == Token::EndOfFile)
+			return;
+
+		// A task that is complete, or cannot be, is parsed right away. The
+		// parser then reports the offending token.
+		pending.append(token);
+		if (!accept(token) || state == State::Start) {
+			parsePending();
+		}
+	}
+
+	if (tokenizer.status() == Tokenizer::Status::Failed)
+		throw ParserError(tokenizer.errorMessage());
+}
+
+bool StreamParser::accept(const Token& token)
+{
+	// Follows Parser::task(), token by token.
+	switch (state) {
+		case State::Start:
+			if (token.type != Token::TagStart)
+				return false;
+			state = State::TagName;
+			return true;
+
+		case State::TagName:
+			if (token.type != Token::Identifier)
+				return false;
+			if (inElement) {
+				if (token.data != QLatin1String("gap") && token.data != QLatin1String("extra"))
+					return false;
+				element = token.data;
+			} else if (token.data != QLatin1String("task")) {
+				return false;
+			}
+			state = State::Attributes;
+			return true;
+
+		case State::Attributes:
+			if (token.type == Token::Identifier) {
+				state = State::Equals;
+				return true;
+			}
+			if (token.type != Token::TagEnd)
+				return false;
+			state = inElement ? State::ElementText : State::Content;
+			return true;
+
+		case State::Equals:
+			if (token.type != Token::Equals)
+				return false;
+			state = State::Value;
+			return true;
+
+		case State::Value:
+			if (token.type != Token::Quoted)
+				return false;
+			state = State::Attributes;
+			return true;
+
+		case State::Content:
+			if (token.type == Token::TagStart) {
+				inElement = true;
+				state = State::TagName;
+			} else if (token.type == Token::ClosingTagStart) {
+				state = State::ClosingName;
+			} else if (token.type != Token::Text) {
+				return false;
+			}
+			return true;
+
+		case State::ElementText:
+			if (token.type != Token::Text)
+				return false;
+			state = State::ElementClose;
+			return true;
+
+		case State::ElementClose:
+			if (token.type != Token::ClosingTagStart)
+				return false;
+			state = State::ClosingName;
+			return true;
+
+		case State::ClosingName:
+			if (token.type != Token::Identifier)
+				return false;
+			if (inElement ? token.data != element : token.data != QLatin1String("task"))
+				return false;
+			state = State::ClosingEnd;
+			return true;
+
+		case State::ClosingEnd:
+			if (token.type != Token::TagEnd)
+				return false;
+			state = inElement ? State::Content : State::Start;
+			inElement = false;
+			return true;
+	}
+	return false;
+}
+
+void StreamParser::parsePending()
+{
+	state = State::Start;
+	inElement = false;
+
+	if (pending.last().type != Token::EndOfFile) {
+		pending.append(Token(Token::EndOfFile));
+	}
+	Document doc = parser.parse(pending);
+	pending.clear();
+	for (int i = 0; i < doc.tasks.size(); ++i) {
+		completed.appendTask(doc, i);
+	}
+}
+
+} // namespace ltf
+} // namespace ipp3
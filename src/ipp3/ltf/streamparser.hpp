@@ -0,0 +1,96 @@
+#ifndef IPP3_LTF_STREAMPARSER_HPP
+#define IPP3_LTF_STREAMPARSER_HPP
+
+#include "document.hpp"
+#include "parser.hpp"
+#include "tokenizer.hpp"
+
+#include <QtCore/QByteArray>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+namespace ipp3 {
+namespace ltf {
+
+/**
+ * Parses a LTF document pushed piece by piece, for input arriving from a
+ * pipe or a socket.
+ *
+ * @details
+ * Input goes to a Tokenizer with feed(). The tokens of the task being read
+ * are kept until its closing tag and then the task is parsed on its own,
+ * so every task is available as soon as its last byte arrives. The tasks
+ * share one arena, which lives as long as any of them. Every token is
+ * checked against the structure of a task as it arrives, so an error is
+ * reported by the feed() that brings the offending token, not only when
+ * the task is closed.
+ */
+class StreamParser
+{
+public:
+	StreamParser();
+
+	/**
+	 * Adds a piece of UTF-8 input. May throw a ParserError.
+	 */
+	void feed(const QByteArray& utf8);
+
+	/**
+	 * Marks the end of input. Throws a ParserError if the input does not
+	 * end where a document can.
+	 */
+	void finish();
+
+	/**
+	 * Takes the tasks completed since the last call.
+	 */
+	Document takeTasks();
+
+	/**
+	 * Whether finish() was called and all the input was parsed.
+	 */
+	bool isFinished();
+
+private:
+	/**
+	 * Where the pending tokens stopped in the structure of a task.
+	 */
+	enum class State
+	{
+		Start,
+		TagName,
+		Attributes,
+		Equals,
+		Value,
+		Content,
+		ElementText,
+		ElementClose,
+		ClosingName,
+		ClosingEnd
+	};
+
+	void readTokens();
+
+	/**
+	 * Moves the state past @a token. Returns false if the token cannot
+	 * come next.
+	 */
+	bool accept(const Token& token);
+	void parsePending();
+
+	Tokenizer tokenizer;
+	// All tasks are allocated in one arena.
+	Parser parser;
+	// Tokens of the task being read.
+	QVector<Token> pending;
+	State state;
+	// Inside a gap or an extra, and its name.
+	bool inElement;
+	QString element;
+	Document completed;
+};
+
+} // namespace ltf
+} // namespace ipp3
+
+#endif // IPP3_LTF_STREAMPARSER_HPP
@@ -0,0 +1,253 @@
+#include "taskindex.hpp"
+#include "parser.hpp"
+#include "scan.hpp"
+
+#include <QtCore/QBuffer>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDateTime>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QSaveFile>
+#include <QtCore/QtEndian>
+
+#include <cctype>
+#include <cstring>
+
+namespace ipp3 {
+namespace ltf {
+
+// Sidecar layout, little endian: magic, version (32 bits), size of the
+// LTF file (64 bits), its modification time in ms (64 bits), number of
+// tasks (32 bits), zero (32 bits), then offset, length and hash of every
+// task (64 bits each).
+
+static const char magic[] = "LTFI";
+static const quint32 formatVersion = 1;
+static const int headerSize = 32;
+static const int entrySize = 24;
+
+TaskIndex::TaskIndex() :
+	storedOffset(0),
+	count(0)
+{
+}
+
+QString TaskIndex::pathFor(const QString& fileName)
+{
+	return fileName + ".idx";
+}
+
+TaskIndex TaskIndex::forFile(const QString& fileName)
+{
+	QFileInfo info(fileName);
+	qint64 modified = info.lastModified().toMSecsSinceEpoch();
+
+	// Only the header is checked here, the entries are read when needed.
+	QSharedPointer<QFile> sidecar(new QFile(pathFor(fileName)));
+	if (sidecar->open(QFile::ReadOnly)) {
+		QByteArray data = sidecar->read(headerSize);
+		const uchar* bytes = reinterpret_cast<const uchar*>(data.constData());
+		int count = data.size() == headerSize ? int(qFromLittleEndian<quint32>(bytes + 24)) : -1;
+		if (count >= 0 && sidecar->size() == headerSize + qint64(count) * entrySize
+			&& data == header(info.size(), modified, count)) {
+			TaskIndex index;
+			index.stored = sidecar;
+			index.storedOffset = headerSize;
+			index.count = count;
+			return index;
+		}
+		// Closed before the sidecar is written again.
+		sidecar->close();
+	}
+
+	QFile file(fileName);
+	if (!file.open(QFile::ReadOnly))
+		throw ParserError("Cannot open the file " + fileName + ".");
+	TaskIndex index = build(file.readAll());
+
+	// Without the sidecar the index is just built again next time.
+	QSaveFile out(pathFor(fileName));
+	if (out.open(QFile::WriteOnly)) {
+		out.write(header(info.size(), modified, index.size()) + index.entriesData());
+		out.commit();
+	}
+	return index;
+}
+
+TaskIndex TaskIndex::build(const QByteArray& data)
+{
+	// Text cannot contain '<' (it has entities instead), so every '<'
+	// outside of a quoted attribute value starts a tag. Tasks do not nest.
+	enum class State { Text, Tag, Quoted };
+	State state = State::Text;
+	TaskIndex index;
+	int tagStart = 0;
+	int taskStart = -1;
+	bool closing = false;
+	bool nameDone = false;
+	QByteArray name;
+	const char* begin = data.constData();
+	const char* end = begin + data.size();
+
+	for (int i = 0; i < data.size(); ++i) {
+		char c = data[i];
+		switch (state) {
+			case State::Text:
+				// Text is skipped a run at a time.
+				i = int(findEither(begin + i, end, '<', '<') - begin);
+				if (i < data.size()) {
+					state = State::Tag;
+					tagStart = i;
+					closing = i + 1 < data.size() && data[i + 1] == '/';
+					i += closing;
+					nameDone = false;
+					name.clear();
+				}
+				break;
+
+			case State::Tag:
+				if (c == '>') {
+					state = State::Text;
+					if (name == "task" && !closing) {
+						taskStart = tagStart;
+					} else if (name == "task" && taskStart >= 0) {
+						QByteArray task = data.mid(taskStart, i + 1 - taskStart);
+						index.entries.append(Entry {taskStart, task.size(), hash(task)});
+						taskStart = -1;
+					}
+				} else if (c == '"') {
+					state = State::Quoted;
+					nameDone = true;
+				} else if (c == '=' || isspace(uchar(c))) {
+					nameDone = !name.isEmpty();
+				} else if (!nameDone) {
+					name.append(c);
+				}
+				break;
+
+			case State::Quoted:
+				if (c == '"') {
+					state = State::Tag;
+				}
+				break;
+		}
+	}
+
+	// The scan does not check the syntax, the parser does. A valid file
+	// has exactly the tasks that were found.
+	Document doc = Parser().parse(data);
+	if (doc.tasks.size() != index.entries.size())
+		throw ParserError("Cannot index the tasks of the file.");
+
+	index.count = index.entries.size();
+	return index;
+}
+
+TaskIndex TaskIndex::fromEntries(const QByteArray& data)
+{
+	if (data.size() % entrySize != 0)
+		throw ParserError("The task index is damaged.");
+
+	// The buffer shares the data, raw data included, without copying it.
+	QSharedPointer<QBuffer> buffer(new QBuffer());
+	buffer->setData(data);
+	buffer->open(QBuffer::ReadOnly);
+
+	TaskIndex index;
+	index.stored = buffer;
+	index.count = data.size() / entrySize;
+	return index;
+}
+
+QByteArray TaskIndex::entriesData() const
+{
+	QByteArray data;
+	data.reserve(count * entrySize);
+	for (int i = 0; i < count; ++i) {
+		Entry entry = at(i);
+		uchar bytes[entrySize];
+		qToLittleEndian(quint64(entry.offset), bytes);
+		qToLittleEndian(quint64(entry.length), bytes + 8);
+		qToLittleEndian(entry.hash, bytes + 16);
+		data.append(reinterpret_cast<const char*>(bytes), entrySize);
+	}
+	return data;
+}
+
+int TaskIndex::size() const
+{
+	return count;
+}
+
+TaskIndex::Entry TaskIndex::at(int i) const
+{
+	if (!stored)
+		return entries[i];
+
+	QByteArray data;
+	if (stored->seek(storedOffset + qint64(i) * entrySize)) {
+		data = stored->read(entrySize);
+	}
+	if (data.size() != entrySize)
+		throw ParserError("Cannot read the task index.");
+
+	const uchar* bytes = reinterpret_cast<const uchar*>(data.constData());
+	return Entry {
+		qint64(qFromLittleEndian<quint64>(bytes)),
+		qint64(qFromLittleEndian<quint64>(bytes + 8)),
+		qFromLittleEndian<quint64>(bytes + 16)
+	};
+}
+
+Document TaskIndex::parse(QIODevice* device, const QVector<int>& tasks) const
+{
+	// All tasks are allocated in one arena.
+	QSharedPointer<Arena> arena(new Arena());
+	Parser parser;
+	parser.setArena(arena);
+
+	Document doc;
+	doc.tasks.reserve(tasks.size());
+	doc.arenas.append(arena);
+
+	for (int i : tasks) {
+		if (i < 0 || i >= count)
+			throw ParserError(QString("There is no task %1.").arg(i));
+
+		Entry entry = at(i);
+		QByteArray data;
+		if (device->seek(entry.offset)) {
+			data = device->read(entry.length);
+		}
+		if (data.size() != entry.length || hash(data) != entry.hash)
+			throw ParserError("The task index is out of date.");
+
+		Document task = parser.parse(data);
+		if (task.tasks.size() != 1)
+			throw ParserError("The task index is out of date.");
+		doc.tasks.append(task.tasks[0]);
+	}
+
+	return doc;
+}
+
+quint64 TaskIndex::hash(const QByteArray& data)
+{
+	QByteArray digest = QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+	return qFromLittleEndian<quint64>(reinterpret_cast<const uchar*>(digest.constData()));
+}
+
+QByteArray TaskIndex::header(qint64 fileSize, qint64 modified, int count)
+{
+	uchar data[headerSize];
+	memcpy(data, magic, 4);
+	qToLittleEndian(formatVersion, data + 4);
+	qToLittleEndian(quint64(fileSize), data + 8);
+	qToLittleEndian(quint64(modified), data + 16);
+	qToLittleEndian(quint32(count), data + 24);
+	qToLittleEndian(quint32(0), data + 28);
+	return QByteArray(reinterpret_cast<const char*>(data), headerSize);
+}
+
+} // namespace ltf
+} // namespace ipp3
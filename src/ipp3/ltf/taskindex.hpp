@@ -0,0 +1,100 @@
+#ifndef IPP3_LTF_TASKINDEX_HPP
+#define IPP3_LTF_TASKINDEX_HPP
+
+#include "document.hpp"
+
+#include <QtCore/QByteArray>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+class QIODevice;
+
+namespace ipp3 {
+namespace ltf {
+
+/**
+ * Byte ranges of the tasks of a LTF file.
+ *
+ * @details
+ * With the index, any subset of tasks is parsed by seeking straight to
+ * them, at a cost independent of the size of the file. The index is
+ * built once by scanning (and fully parsing) the file and is kept in a
+ * sidecar file next to it, which is rebuilt when the size or the
+ * modification time of the file changes. Every task also has a hash of
+ * its bytes, checked when it is read.
+ *
+ * An index read from the sidecar (or from a bundle, which stores the
+ * entries too) reads the entries of the tasks asked for only, so opening
+ * it costs the same for any number of tasks.
+ */
+class TaskIndex
+{
+public:
+	struct Entry {
+		qint64 offset;
+		qint64 length;
+		quint64 hash;
+	};
+
+	/**
+	 * The sidecar file of a LTF file.
+	 */
+	static QString pathFor(const QString& fileName);
+
+	/**
+	 * Uses the sidecar file if its header shows it is up to date, otherwise
+	 * builds the index and tries to write the sidecar. May throw a
+	 * ParserError.
+	 */
+	static TaskIndex forFile(const QString& fileName);
+
+	/**
+	 * Builds the index of LTF text. May throw a ParserError.
+	 */
+	static TaskIndex build(const QByteArray& data);
+
+	/**
+	 * An index over entries as given by entriesData(). @a data may point
+	 * into a mapping, which must outlive the index. Throws a ParserError
+	 * if it is not a whole number of entries.
+	 */
+	static TaskIndex fromEntries(const QByteArray& data);
+
+	/**
+	 * The entries as stored in the sidecar and in bundles.
+	 */
+	QByteArray entriesData() const;
+
+	int size() const;
+
+	/**
+	 * The entry of task @a i, read from storage if the index came from
+	 * there. May throw a ParserError.
+	 */
+	Entry at(int i) const;
+
+	/**
+	 * Parses the given tasks of the indexed text, read from @a device, in
+	 * the given order. May throw a ParserError.
+	 */
+	Document parse(QIODevice* device, const QVector<int>& tasks) const;
+
+private:
+	TaskIndex();
+
+	static quint64 hash(const QByteArray& data);
+	static QByteArray header(qint64 fileSize, qint64 modified, int count);
+
+	// Either the entries of a built index, or the sidecar or bundle data
+	// to read them from, starting at storedOffset.
+	QVector<Entry> entries;
+	QSharedPointer<QIODevice> stored;
+	qint64 storedOffset;
+	int count;
+};
+
+} // namespace ltf
+} // namespace ipp3
+
+#endif // IPP3_LTF_TASKINDEX_HPP
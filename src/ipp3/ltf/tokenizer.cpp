@@ -1,27 +1,126 @@
 #include "tokenizer.hpp"
+#include "scan.hpp"
 
 #include <QtCore/QTextStream>
 
+#include <cstring>
+
 namespace ipp3 {
 namespace ltf {
 
+static const char byteOrderMark[] = "\xEF\xBB\xBF";
+
 Tokenizer::Tokenizer(QTextStream* stream) :
 	stream(stream),
+	position(nullptr),
+	chunkEnd(nullptr),
+	bytes(nullptr),
+	bytesEnd(nullptr),
+	pushing(false),
+	atStart(false),
 	status_(Status::Available),
-	state(State::Default)
+	state(State::Default),
+	entityLength(0)
 {
-	input.reset([stream] (QChar* c) -> bool {
-		(*stream) >> (*c); 
-		return stream->status() == QTextStream::Ok;
-	});
+	// Read the first token into the output queue or fail trying.
+	pump();
+}
 
-	entities.insert("lt", '<');
-	entities.insert("gt", '>');
-	entities.insert("amp", '&');
-	entities.insert("quot", '"');
+Tokenizer::Tokenizer(const QByteArray& utf8) :
+	stream(nullptr),
+	position(nullptr),
+	chunkEnd(nullptr),
+	utf8(utf8),
+	bytes(this->utf8.constData()),
+	bytesEnd(bytes),
+	pushing(false),
+	atStart(true),
+	status_(Status::Available),
+	state(State::Default),
+	entityLength(0)
+{
+	updateInput();
+	pump();
+}
 
-	// Read the first token into the output queue or fail trying.
-	while (status_ == Status::Available && output.empty()) {
+Tokenizer::Tokenizer() :
+	stream(nullptr),
+	position(nullptr),
+	chunkEnd(nullptr),
+	bytes(utf8.constData()),
+	bytesEnd(bytes),
+	pushing(true),
+	atStart(true),
+	status_(Status::Available),
+	state(State::Default),
+	entityLength(0)
+{
+}
+
+void Tokenizer::feed(const QByteArray& data)
+{
+	Q_ASSERT(pushing);
+
+	// Whatever was not taken yet goes first.
+	int taken = int(bytes - utf8.constData());
+	if (taken == utf8.size()) {
+		utf8 = data;
+	} else {
+		utf8 = utf8.mid(taken) + data;
+	}
+	bytes = utf8.constData();
+	updateInput();
+}
+
+void Tokenizer::finish()
+{
+	Q_ASSERT(pushing);
+	pushing = false;
+	updateInput();
+}
+
+/**
+ * The length of @a data without a character cut off at its end.
+ */
+static int completeLength(const char* data, int size)
+{
+	for (int i = 1; i <= qMin(3, size); ++i) {
+		uchar c = uchar(data[size - i]);
+		if ((c & 0xC0) == 0x80)
+			continue;
+		int length = c < 0x80 ? 1 : c < 0xE0 ? 2 : c < 0xF0 ? 3 : 4;
+		return length > i ? size - i : size;
+	}
+	return size;
+}
+
+void Tokenizer::updateInput()
+{
+	int size = int(utf8.constData() + utf8.size() - bytes);
+	if (atStart) {
+		int markSize = int(sizeof(byteOrderMark)) - 1;
+		if (pushing && size < markSize && memcmp(bytes, byteOrderMark, size) == 0) {
+			// Possibly the start of a byte order mark.
+			bytesEnd = bytes;
+			return;
+		}
+		if (size >= markSize && memcmp(bytes, byteOrderMark, markSize) == 0) {
+			bytes += markSize;
+			size -= markSize;
+		}
+		atStart = false;
+	}
+	bytesEnd = bytes + (pushing ? completeLength(bytes, size) : size);
+}
+
+bool Tokenizer::hasInput() const
+{
+	return position != chunkEnd || bytes != bytesEnd;
+}
+
+void Tokenizer::pump()
+{
+	while (output.isEmpty() && status_ == Status::Available && (!pushing || hasInput())) {
 		step();
 	}
 }
@@ -33,7 +132,7 @@ Token Tokenizer::read()
 
 	// Consume input until we have 2 tokens in the ouput queue or until 
 	// we encounter EOF or an error.
-	while (status_ == Status::Available && output.size() < 2) {
+	while (status_ == Status::Available && output.size() < 2 && (!pushing || hasInput())) {
 		step();
 	}
 
@@ -46,8 +145,11 @@ Tokenizer::Status Tokenizer::status()
 	// We may have encountered an error or EOF internally because we are
 	// buffering output, but as long as there are tokens in the output queue
 	// the user should see status as Available.
+	pump();
 	if (!output.isEmpty())
 		return Status::Available;
+	if (status_ == Status::Available)
+		return Status::NeedsInput;
 	return status_;
 }
 
@@ -68,7 +170,7 @@ void Tokenizer::fail(const QString& msg)
 	errorMessage_ = msg;
 }
 
-void Tokenizer::finish()
+void Tokenizer::complete()
 {
 	yield(Token::EndOfFile);
 	status_ = Status::Completed;
@@ -82,6 +184,98 @@ void Tokenizer::flushText()
 	}
 }
 
+// ASCII characters of UTF-8 input are taken as they are, without going
+// through the chunk.
+
+static bool isAscii(const char* bytes, const char* bytesEnd)
+{
+	return bytes != bytesEnd && uchar(*bytes) < 0x80;
+}
+
+bool Tokenizer::getChar(QChar* c)
+{
+	if (position == chunkEnd) {
+		if (isAscii(bytes, bytesEnd)) {
+			*c = QLatin1Char(*bytes++);
+			return true;
+		}
+		if (!fillChunk())
+			return false;
+	}
+	*c = *position++;
+	return true;
+}
+
+bool Tokenizer::peekChar(QChar* c)
+{
+	if (position == chunkEnd) {
+		if (isAscii(bytes, bytesEnd)) {
+			*c = QLatin1Char(*bytes);
+			return true;
+		}
+		if (!fillChunk())
+			return false;
+	}
+	*c = *position;
+	return true;
+}
+
+void Tokenizer::skipChar()
+{
+	if (position == chunkEnd && isAscii(bytes, bytesEnd)) {
+		++bytes;
+	} else if (position != chunkEnd || fillChunk()) {
+		++position;
+	}
+}
+
+bool Tokenizer::fillChunk()
+{
+	if (stream) {
+		chunk = stream->read(chunkSize);
+	} else if (bytes != bytesEnd) {
+		// One character, its length is given by the leading byte.
+		uchar lead = uchar(*bytes);
+		int length = lead < 0xC0 ? 1 : lead < 0xE0 ? 2 : lead < 0xF0 ? 3 : 4;
+		length = qMin(length, int(bytesEnd - bytes));
+		chunk = QString::fromUtf8(bytes, length);
+		bytes += length;
+	} else {
+		chunk.clear();
+	}
+	position = chunk.constData();
+	chunkEnd = position + chunk.size();
+	return !chunk.isEmpty();
+}
+
+bool Tokenizer::takeRun(QString* buffer, char a, char b, char* delimiter)
+{
+	*delimiter = 0;
+
+	if (position == chunkEnd && bytes != bytesEnd) {
+		// The delimiters are ASCII, so a run never ends inside a character
+		// and can be decoded on its own.
+		const char* found = findEither(bytes, bytesEnd, a, b);
+		buffer->append(QString::fromUtf8(bytes, int(found - bytes)));
+		bytes = found;
+		if (bytes != bytesEnd) {
+			*delimiter = *bytes++;
+		}
+		return true;
+	}
+
+	if (position == chunkEnd && !fillChunk())
+		return false;
+
+	const QChar* found = findEither(position, chunkEnd, QLatin1Char(a), QLatin1Char(b));
+	buffer->append(position, int(found - position));
+	position = found;
+	if (position != chunkEnd) {
+		*delimiter = (position++)->toLatin1();
+	}
+	return true;
+}
+
 void Tokenizer::flushIdentifier()
 {
 	if (!identifier.isEmpty()) {
@@ -121,21 +315,19 @@ void Tokenizer::step()
 
 void Tokenizer::stepDefault()
 {
-	QChar c;
-
-	if (!input.get(&c)) {
+	// Everything up to the next delimiter is text.
+	char delimiter;
+	if (!takeRun(&text, '&', '<', &delimiter)) {
 		flushText();
-		finish();
+		complete();
 		return;
 	}
 
-	if (c == '&') {
+	if (delimiter == '&') {
 		state = State::Entity;
-	} else if (c == '<') {
+	} else if (delimiter == '<') {
 		flushText();
 		state = State::LT;
-	} else {
-		text.append(c);
 	}
 }
 
@@ -143,23 +335,23 @@ void Tokenizer::stepEntity(QString& buffer, State cont)
 {
 	QChar c;
 
-	if (!input.get(&c)) {
-		fail("Unfinished entity " + entity);
+	if (!getChar(&c)) {
+		fail("Unfinished entity " + QString::fromLatin1(entity, entityLength));
 		return;
 	}
 
 	if (c == ';') {
-		auto it = entities.find(entity);
-
-		if (it == entities.end()) {
-			fail("Invalid entity " + entity);
+		if (!decodeEntity(entity, entityLength, &buffer)) {
+			fail("Invalid entity " + QString::fromLatin1(entity, entityLength));
 		} else {
-			buffer.append(it.value());
-			entity.clear();
+			entityLength = 0;
 			state = cont;
 		}
+	} else if (c.unicode() < 0x80 && entityLength < maxEntityLength) {
+		entity[entityLength++] = c.toLatin1();
 	} else {
-		entity.append(c);
+		// Too long or not ASCII, no entity has such a name.
+		fail("Invalid entity " + QString::fromLatin1(entity, entityLength) + c);
 	}
 }
 
@@ -167,35 +359,53 @@ void Tokenizer::stepLT()
 {
 	QChar c;
 
-	if (!input.peek(&c)) {
+	if (!peekChar(&c)) {
 		yield(Token::TagStart);
-		finish();
+		complete();
 		return;
 	}
 
 	state = State::InTag;
 	if (c == '/') {
 		yield(Token::ClosingTagStart);
-		input.skip();
+		skipChar();
 	} else {
 		yield(Token::TagStart);
 	}
 }
 
+// ASCII first, tags rarely contain anything else.
+
+static bool isSpace(QChar c)
+{
+	ushort u = c.unicode();
+	if (u < 0x80)
+		return u == ' ' || (u >= '\t' && u <= '\r');
+	return c.isSpace();
+}
+
+static bool isIdentifierChar(QChar c)
+{
+	ushort u = c.unicode();
+	if (u < 0x80)
+		return (u >= 'a' && u <= 'z') || (u >= 'A' && u <= 'Z') || (u >= '0' && u <= '9') || u == '_';
+	return c.isLetterOrNumber();
+}
+
 void Tokenizer::stepInTag()
 {
 	QChar c;
 
-	if (!input.get(&c)) {
+	if (!getChar(&c)) {
 		flushIdentifier();
-		finish();
+		complete();
 		return;
 	}
 
 	if (c == '=') {
 		flushIdentifier();
 		yield(Token::Equals);
-	} else if (c.isSpace()) {
+	} else if (isSpace(c)) {
 		flushIdentifier();
 	} else if (c == '"') {
 		flushIdentifier();
@@ -204,7 +414,7 @@ void Tokenizer::stepInTag()
 		flushIdentifier();
 		yield(Token::TagEnd);
 		state = State::Default;
-	} else if (c.isLetterOrNumber() || c == '_') {
+	} else if (isIdentifierChar(c)) {
 		identifier.append(c);
 	} else {
 		fail(QString("Invalid character inside a tag: ") + c);
@@ -213,21 +423,18 @@ void Tokenizer::stepInTag()
 
 void Tokenizer::stepQuoted()
 {
-	QChar c;
-
-	if (!input.get(&c)) {
+	char delimiter;
+	if (!takeRun(&quoted, '&', '"', &delimiter)) {
 		fail("Unfinished quoted string: \"" + quoted + "\"");
 		return;
 	}
 
-	if (c == '&') {
+	if (delimiter == '&') {
 		state = State::QuotedEntity;
-	} else if (c == '"') {
+	} else if (delimiter == '"') {
 		yield(Token::Quoted, quoted);
 		quoted.clear();
 		state = State::InTag;
-	} else {
-		quoted.append(c);
 	}
 }
 
@@ -2,11 +2,11 @@
 #define IPP3_LTF_TOKENIZER_HPP
 
 #include "token.hpp"
+#include "entities.hpp"
 #include "../peekbuffer.hpp"
 
+#include <QtCore/QByteArray>
 #include <QtCore/QString>
-#include <QtCore/QQueue>
-#include <QtCore/QMap>
 
 class QTextStream;
 
@@ -20,14 +20,37 @@ namespace ltf {
  * 
  * @details
  * The tokenizer is implemented as a finite state machine. It reads input char
- * by char and pushes tokens to a queue. Input is processed as needed, keeping
- * at least one token in the queue (if possible).
+ * by char and pushes tokens to a small ring buffer. Input is processed as
+ * needed, keeping at least one token in the buffer (if possible). Runs of
+ * text and quoted strings are taken whole, up to the next delimiter found
+ * with findEither().
+ *
+ * UTF-8 input is tokenized as bytes: all the syntax is ASCII, so only the
+ * runs of text and quoted strings that become tokens are decoded, and the
+ * odd non-ASCII character elsewhere (in a tag or an entity name).
+ *
+ * UTF-8 input can also be pushed piece by piece with feed(), for input
+ * arriving from a pipe or a socket. The state (including a half read
+ * token, entity or character) is kept between pieces, and tokens are
+ * produced as soon as they are complete. Until finish() is called, the
+ * status is NeedsInput whenever the input given so far has no further
+ * complete token.
  */
 class Tokenizer
 {
 public:
 	Tokenizer(QTextStream* stream);
 
+	/**
+	 * Tokenizes UTF-8 text, a byte order mark is skipped.
+	 */
+	Tokenizer(const QByteArray& utf8);
+
+	/**
+	 * Tokenizes UTF-8 text given with feed().
+	 */
+	Tokenizer();
+
 	enum class Status
 	{
 		/**
@@ -43,9 +66,25 @@ public:
 		/**
 		 * There are no more tokens and an error was encountered.
 		 */
-		Failed
+		Failed,
+
+		/**
+		 * There are no tokens yet, more input has to be fed.
+		 */
+		NeedsInput
 	};
 
+	/**
+	 * Adds a piece of input. A character may be split between pieces, a
+	 * byte order mark is skipped.
+	 */
+	void feed(const QByteArray& utf8);
+
+	/**
+	 * Marks the end of the input fed.
+	 */
+	void finish();
+
 	/**
 	 * Reads a token. Can be called only when the status is Available.
 	 */
@@ -74,32 +113,75 @@ private:
 
 	void yield(Token::Type type, QString data = QString());
 	void fail(const QString& msg);
-	void finish();
+	void complete();
 
 	void flushText();
 	void flushIdentifier();
 
+	/**
+	 * Steps until there is a token, tokenizing ends or (with fed input)
+	 * the input runs out.
+	 */
+	void pump();
+	bool hasInput() const;
+	void updateInput();
 	void step();
+	/**
+	 * Appends to @a buffer everything up to the next @a a or @a b, which is
+	 * consumed and stored in @a delimiter (0 if the run goes on in the next
+	 * step). Returns false at the end of input.
+	 */
+	bool takeRun(QString* buffer, char a, char b, char* delimiter);
 	void stepDefault();
 	void stepEntity(QString &buffer, State cont);
 	void stepLT();
 	void stepInTag();
 	void stepQuoted();
 
+	/**
+	 * Input, read from the stream a chunk at a time. For UTF-8 input the
+	 * chunk holds only the last decoded non-ASCII character.
+	 */
+	//@{
+	bool getChar(QChar* c);
+	bool peekChar(QChar* c);
+	void skipChar();
+	bool fillChunk();
+	//@}
+
+	static const int chunkSize = 16384;
+
+	// A step yields at most two tokens and read() steps only while there
+	// are less than two, so four slots are enough.
+	static const int outputCapacity = 4;
+
 	QTextStream* stream;
-	PeekBuffer<QChar> input;
-	QQueue<Token> output;
+	QString chunk;
+	const QChar* position;
+	const QChar* chunkEnd;
+
+	// Undecoded rest of UTF-8 input, both null for a stream. With fed
+	// input, a character cut in two stays behind bytesEnd until the rest
+	// of it arrives.
+	QByteArray utf8;
+	const char* bytes;
+	const char* bytesEnd;
+	// More input may be fed.
+	bool pushing;
+	// No input was taken yet, a byte order mark may follow.
+	bool atStart;
+	RingBuffer<Token, outputCapacity> output;
 
 	Status status_;
 	QString errorMessage_;
 
 	State state;
 	QString text;
-	QString entity;
+	// Name of the entity being read, always ASCII.
+	char entity[maxEntityLength];
+	int entityLength;
 	QString identifier;
 	QString quoted;
-
-	QMap<QString, QChar> entities;
 };
 
 } // namespace ltf
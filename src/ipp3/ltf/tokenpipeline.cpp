@@ -0,0 +1,109 @@
+#include "tokenpipeline.hpp"
+#include "../trace.hpp"
+
+#include <QtCore/QTextStream>
+
+#include <memory>
+
+namespace ipp3 {
+namespace ltf {
+
+TokenPipeline::TokenPipeline(QTextStream* stream) :
+	stopping(false),
+	position(0),
+	status_(Tokenizer::Status::Available)
+{
+	current.last = false;
+	producer = std::thread([this, stream] () { produce(stream); });
+}
+
+TokenPipeline::TokenPipeline(const QByteArray& utf8) :
+	utf8(utf8),
+	stopping(false),
+	position(0),
+	status_(Tokenizer::Status::Available)
+{
+	current.last = false;
+	producer = std::thread([this] () { produce(nullptr); });
+}
+
+TokenPipeline::~TokenPipeline()
+{
+	stopping.store(true, std::memory_order_relaxed);
+	producer.join();
+}
+
+bool TokenPipeline::read(Token* token)
+{
+	while (position == current.tokens.size()) {
+		if (current.last) {
+			status_ = current.status;
+			return false;
+		}
+
+		// The previous batch is dropped here, on the consumer thread.
+		position = 0;
+		while (!queue.tryPop(&current)) {
+			std::this_thread::yield();
+		}
+	}
+
+	(*token) = std::move(current.tokens[position++]);
+	return true;
+}
+
+Tokenizer::Status TokenPipeline::status() const
+{
+	return status_;
+}
+
+QString TokenPipeline::errorMessage() const
+{
+	Q_ASSERT(status_ == Tokenizer::Status::Failed);
+	return current.errorMessage;
+}
+
+void TokenPipeline::produce(QTextStream* stream)
+{
+	TraceSpan span("TokenPipeline::produce", "load");
+	qint64 tokens = 0;
+
+	std::unique_ptr<Tokenizer> tok(stream ? new Tokenizer(stream) : new Tokenizer(utf8));
+	Batch batch;
+	batch.last = false;
+	batch.tokens.reserve(batchSize);
+	while (tok->status() == Tokenizer::Status::Available) {
+		batch.tokens.append(tok->read());
+		tokens++;
+		if (batch.tokens.size() == batchSize) {
+			if (!push(std::move(batch)))
+				return;
+			batch = Batch();
+			batch.last = false;
+			batch.tokens.reserve(batchSize);
+		}
+	}
+
+	batch.last = true;
+	batch.status = tok->status();
+	if (batch.status == Tokenizer::Status::Failed) {
+		batch.errorMessage = tok->errorMessage();
+	}
+	push(std::move(batch));
+	span.setArg("tokens", tokens);
+}
+
+bool TokenPipeline::push(Batch&& batch)
+{
+	// Also checked when there is space, so an abandoned pipeline stops
+	// tokenizing at the next batch.
+	while (!stopping.load(std::memory_order_relaxed)) {
+		if (queue.tryPush(std::move(batch)))
+			return true;
+		std::this_thread::yield();
+	}
+	return false;
+}
+
+} // namespace ltf
+} // namespace ipp3
@@ -0,0 +1,91 @@
+#ifndef IPP3_LTF_TOKENPIPELINE_HPP
+#define IPP3_LTF_TOKENPIPELINE_HPP
+
+#include "tokenizer.hpp"
+#include "../spscqueue.hpp"
+
+#include <QtCore/QByteArray>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+#include <atomic>
+#include <thread>
+
+class QTextStream;
+
+namespace ipp3 {
+namespace ltf {
+
+/**
+ * Runs a Tokenizer on its own thread, ahead of the reader.
+ *
+ * @details
+ * The producer thread reads and tokenizes the stream and hands the tokens
+ * over in batches through a lock-free queue, so reading and lexing overlap
+ * with whatever the reader does with the tokens. The last batch carries
+ * the final status of the tokenizer, so the reader sees an error only
+ * after all the tokens that came before it, as with a plain Tokenizer.
+ * A side that has to wait yields its time slice.
+ *
+ * The stream must not be used by anyone else while the pipeline exists.
+ */
+class TokenPipeline
+{
+public:
+	static const int batchSize = 512;
+	static const int queueCapacity = 8;
+
+	TokenPipeline(QTextStream* stream);
+	TokenPipeline(const QByteArray& utf8);
+
+	/**
+	 * Stops the producer thread, also if not all tokens were read.
+	 */
+	~TokenPipeline();
+
+	/**
+	 * Reads the next token. Returns false when there are no more tokens,
+	 * the status then tells why.
+	 */
+	bool read(Token* token);
+
+	/**
+	 * Tokenizer::Status::Available until read() returns false.
+	 */
+	Tokenizer::Status status() const;
+
+	/**
+	 * The error message. Can be called only when the status is Failed.
+	 */
+	QString errorMessage() const;
+
+private:
+	struct Batch {
+		QVector<Token> tokens;
+		// Set on the last batch only.
+		bool last;
+		Tokenizer::Status status;
+		QString errorMessage;
+	};
+
+	/**
+	 * Tokenizes @a stream, or utf8 if it is null.
+	 */
+	void produce(QTextStream* stream);
+	bool push(Batch&& batch);
+
+	QByteArray utf8;
+	SpscQueue<Batch, queueCapacity> queue;
+	std::atomic<bool> stopping;
+	std::thread producer;
+
+	// Consumer side.
+	Batch current;
+	int position;
+	Tokenizer::Status status_;
+};
+
+} // namespace ltf
+} // namespace ipp3
+
+#endif // IPP3_LTF_TOKENPIPELINE_HPP
@@ -1,11 +1,223 @@
 #include <QtWidgets/QApplication>
+#include <QtCore/QFile>
+#include <QtCore/QTextStream>
+#include <QtCore/QTimer>
 #include "gui/mainwindow.hpp"
+#include "gui/gap.hpp"
+#include "service/gradingserver.hpp"
+#include "service/client.hpp"
+#include "model.hpp"
+#include "bundle.hpp"
+#include "ltf/streamparser.hpp"
+#include "trace.hpp"
+
+#include <csignal>
+
+static const char* defaultServerName = "ipp3-grader";
+static const int quitPollMs = 200;
+
+/**
+ * Starts tracing if requested with "--trace file" or IPP3_TRACE=file.
+ * The option is removed from the arguments, so that it can be given with
+ * any mode.
+ */
+static void startTracing(int* argc, char** argv)
+{
+	QString fileName = QString::fromLocal8Bit(qgetenv("IPP3_TRACE"));
+	for (int i = 1; i + 1 < *argc; ) {
+		if (qstrcmp(argv[i], "--trace") == 0) {
+			fileName = QString::fromLocal8Bit(argv[i + 1]);
+			for (int j = i; j + 2 <= *argc; ++j) {
+				argv[j] = argv[j + 2];
+			}
+			*argc -= 2;
+		} else {
+			++i;
+		}
+	}
+
+	if (!fileName.isEmpty()) {
+		ipp3::Trace::start(fileName);
+	}
+}
+
+/**
+ * Writes the trace when main() returns, whatever the mode.
+ */
+struct TraceWriter
+{
+	~TraceWriter()
+	{
+		ipp3::Trace::stop();
+	}
+};
+
+// Set by the signal handlers, which can do nothing else safely.
+static volatile std::sig_atomic_t quitRequested = 0;
+
+static void requestQuit(int)
+{
+	quitRequested = 1;
+}
+
+/**
+ * Runs the grading service (see "docs/service.txt") without any GUI.
+ */
+static int serve(int argc, char** argv)
+{
+	QCoreApplication app(argc, argv);
+	QString name = argc > 2 ? argv[2] : defaultServerName;
+
+	ipp3::service::GradingServer server;
+	if (!server.listen(name)) {
+		QTextStream(stderr) << "Cannot listen on " << name << ": " << server.errorString() << endl;
+		return 1;
+	}
+
+	// Stopped with SIGINT or SIGTERM, the flag is polled from the event loop.
+	std::signal(SIGINT, requestQuit);
+	std::signal(SIGTERM, requestQuit);
+	QTimer quitTimer;
+	QObject::connect(&quitTimer, &QTimer::timeout, &app, [&app] () {
+		if (quitRequested) {
+			app.quit();
+		}
+	});
+	quitTimer.start(quitPollMs);
+
+	return app.exec();
+}
+
+/**
+ * Prints the memory used by a test file once loaded.
+ */
+static int memoryReport(int argc, char** argv)
+{
+	QCoreApplication app(argc, argv);
+	QTextStream out(stdout);
+	if (argc < 3) {
+		out << "Usage: " << argv[0] << " --memory-report file.ltf" << endl;
+		return 1;
+	}
+
+	QString error;
+	QSharedPointer<const ipp3::Bank> bank = ipp3::Bank::load(argv[2], ipp3::Bank::Images::Load, &error);
+	if (!bank) {
+		out << error << endl;
+		return 1;
+	}
+
+	ipp3::Model model(bank);
+	out << model.memoryReport().toString();
+	return 0;
+}
+
+/**
+ * Packs a test file and its images into a bundle.
+ */
+static int bundle(int argc, char** argv)
+{
+	QCoreApplication app(argc, argv);
+	QTextStream out(stdout);
+	if (argc < 4) {
+		out << "Usage: " << argv[0] << " --bundle file.ltf file." << ipp3::Bundle::suffix << endl;
+		return 1;
+	}
+
+	// Thumbnails cover displays with a device pixel ratio up to 2.
+	QSize thumbnailSize = QSize(ipp3::gui::Gap::imageWidth, ipp3::gui::Gap::imageHeight) * 2;
+	QString error;
+	if (!ipp3::Bundle::create(argv[2], argv[3], thumbnailSize, &error)) {
+		out << error << endl;
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Parses a test file as it is read, standard input if there is no file,
+ * and prints every task as soon as it is complete. Works on a pipe.
+ */
+static int check(int argc, char** argv)
+{
+	QCoreApplication app(argc, argv);
+	QTextStream out(stdout);
+	QTextStream err(stderr);
+
+	QFile file;
+	bool opened;
+	if (argc > 2) {
+		file.setFileName(argv[2]);
+		opened = file.open(QFile::ReadOnly | QFile::Unbuffered);
+	} else {
+		opened = file.open(stdin, QFile::ReadOnly | QFile::Unbuffered);
+	}
+	if (!opened) {
+		err << "Cannot open " << (argc > 2 ? argv[2] : "the standard input") << endl;
+		return 1;
+	}
+
+	ipp3::ltf::StreamParser parser;
+	int tasks = 0;
+	try {
+		for (;;) {
+			// A line at a time, so that nothing waits for more input to fill
+			// a buffer.
+			QByteArray piece = file.readLine(4096);
+			if (piece.isEmpty()) {
+				parser.finish();
+			} else {
+				parser.feed(piece);
+			}
+
+			ipp3::ltf::Document doc = parser.takeTasks();
+			for (const ipp3::ltf::Task& task : doc.tasks) {
+				int gaps = 0;
+				for (const ipp3::Either<ipp3::ltf::Text, ipp3::ltf::Gap>& elem : task.content) {
+					gaps += elem.isRight();
+				}
+				out << "Task " << ++tasks << ": " << gaps << " gaps, " << task.extra.size << " extras" << endl;
+			}
+
+			if (piece.isEmpty())
+				break;
+		}
+	} catch (const ipp3::ltf::ParserError& e) {
+		err << "Error after task " << tasks << ": " << e.message() << endl;
+		return 1;
+	}
+	return 0;
+}
+
+static int request(int argc, char** argv)
+{
+	QCoreApplication app(argc, argv);
+	return ipp3::service::runClient(argc > 2 ? argv[2] : defaultServerName);
+}
 
 int main(int argc, char** argv)
 {
+	startTracing(&argc, argv);
+	TraceWriter traceWriter;
+
+	if (argc > 1 && qstrcmp(argv[1], "--serve") == 0)
+		return serve(argc, argv);
+	if (argc > 1 && qstrcmp(argv[1], "--request") == 0)
+		return request(argc, argv);
+	if (argc > 1 && qstrcmp(argv[1], "--memory-report") == 0)
+		return memoryReport(argc, argv);
+	if (argc > 1 && qstrcmp(argv[1], "--bundle") == 0)
+		return bundle(argc, argv);
+	if (argc > 1 && qstrcmp(argv[1], "--check") == 0)
+		return check(argc, argv);
+
 	QApplication app(argc, argv);
 	srand(time(0));
 	ipp3::gui::MainWindow window;
 	window.show();
+	// "--exam count file" starts with a test drawn from the file.
+	if (argc > 3 && qstrcmp(argv[1], "--exam") == 0) {
+		window.openExam(QString::fromLocal8Bit(argv[3]), QByteArray(argv[2]).toInt());
+	}
 	return app.exec();
 }
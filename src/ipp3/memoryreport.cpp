@@ -0,0 +1,138 @@
+#include "memoryreport.hpp"
+
+#include <QtGui/QImage>
+#include <QtGui/QPixmap>
+
+namespace ipp3 {
+
+MemoryReport::MemoryReport()
+{
+	for (int i = 0; i < CategoriesCount; ++i) {
+		bytes_[i] = 0;
+		objects_[i] = 0;
+	}
+}
+
+qint64 MemoryReport::bytes(Category category) const
+{
+	return bytes_[category];
+}
+
+qint64 MemoryReport::objects(Category category) const
+{
+	return objects_[category];
+}
+
+qint64 MemoryReport::totalBytes() const
+{
+	qint64 total = 0;
+	for (int i = 0; i < CategoriesCount; ++i) {
+		total += bytes_[i];
+	}
+	return total;
+}
+
+QString MemoryReport::name(Category category)
+{
+	switch (category) {
+		case WordStrings:
+			return "Word strings";
+
+		case PhraseLists:
+			return "Phrase lists";
+
+		case TextRuns:
+			return "Text runs";
+
+		case Indices:
+			return "Indices";
+
+		case SessionState:
+			return "Session state";
+
+		case Images:
+			return "Decoded images";
+
+		case Pixmaps:
+			return "Cached pixmaps";
+
+		case Widgets:
+			return "Widgets";
+
+		case CategoriesCount:
+			break;
+	}
+	return QString();
+}
+
+QString MemoryReport::toString() const
+{
+	auto line = [] (const QString& name, qint64 bytes, const QString& objects) {
+		return QString("%1 %2 KiB %3\n").arg(name, -16)
+			.arg(QString::number(bytes / 1024.0, 'f', 1), 12).arg(objects, 10);
+	};
+
+	QString table;
+	for (int i = 0; i < CategoriesCount; ++i) {
+		Category category = Category(i);
+		table += line(name(category), bytes(category), QString::number(objects(category)));
+	}
+	table += line("Total", totalBytes(), QString());
+	return table;
+}
+
+void MemoryReport::add(Category category, qint64 bytes, qint64 objects)
+{
+	bytes_[category] += bytes;
+	objects_[category] += objects;
+}
+
+void MemoryReport::addString(Category category, const QString& string)
+{
+	// QString data: header, UTF-16 payload and the terminating null.
+	if (string.capacity() > 0 && isNew(string.constData())) {
+		add(category, vectorHeaderBytes + (string.capacity() + 1) * 2);
+	}
+}
+
+void MemoryReport::addStringList(Category category, const QStringList& list)
+{
+	// QList of QString is an array of pointer-sized QString handles,
+	// its storage address identifies shared copies.
+	if (!list.isEmpty() && isNew(&list.first())) {
+		add(category, vectorHeaderBytes + list.size() * sizeof(void*));
+		for (const QString& string : list) {
+			addString(WordStrings, string);
+		}
+	}
+}
+
+void MemoryReport::addImage(Category category, const QImage& image)
+{
+	if (!image.isNull() && !seenImages.contains(image.cacheKey())) {
+		seenImages.insert(image.cacheKey());
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+		add(category, image.sizeInBytes());
+#else
+		add(category, image.byteCount());
+#endif
+	}
+}
+
+void MemoryReport::addPixmap(Category category, const QPixmap& pixmap)
+{
+	if (!pixmap.isNull() && !seenImages.contains(pixmap.cacheKey())) {
+		seenImages.insert(pixmap.cacheKey());
+		add(category, qint64(pixmap.width()) * pixmap.height() * pixmap.depth() / 8);
+	}
+}
+
+bool MemoryReport::isNew(const void* data)
+{
+	if (seen.contains(data))
+		return false;
+	seen.insert(data);
+	return true;
+}
+
+} // namespace ipp3
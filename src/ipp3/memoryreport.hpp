@@ -0,0 +1,87 @@
+#ifndef IPP3_MEMORYREPORT_HPP
+#define IPP3_MEMORYREPORT_HPP
+
+#include <QtCore/QSet>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QVector>
+
+class QImage;
+class QPixmap;
+
+namespace ipp3 {
+
+/**
+ * Estimated heap memory by category.
+ *
+ * @details
+ * Sizes include Qt's container headers and allocated capacity. Implicitly
+ * shared data (a phrase's words that are also a gap's answer, the same
+ * image used by several gaps) is counted once per report. Widgets are
+ * opaque, they are counted with a fixed estimate per widget.
+ */
+class MemoryReport
+{
+public:
+	enum Category
+	{
+		WordStrings,
+		PhraseLists,
+		TextRuns,
+		Indices,
+		SessionState,
+		Images,
+		Pixmaps,
+		Widgets,
+		CategoriesCount
+	};
+
+	// Rough size of a QWidget with its private data, style and palette.
+	static const int estimatedWidgetBytes = 1200;
+
+	MemoryReport();
+
+	qint64 bytes(Category category) const;
+	qint64 objects(Category category) const;
+	qint64 totalBytes() const;
+
+	static QString name(Category category);
+
+	/**
+	 * A table with a line per category.
+	 */
+	QString toString() const;
+
+	/**
+	 * Accounting, called by the reported objects.
+	 */
+	//@{
+	void add(Category category, qint64 bytes, qint64 objects = 1);
+	void addString(Category category, const QString& string);
+	void addStringList(Category category, const QStringList& list);
+	void addImage(Category category, const QImage& image);
+	void addPixmap(Category category, const QPixmap& pixmap);
+
+	template <typename T>
+	void addVector(Category category, const QVector<T>& vector)
+	{
+		if (vector.capacity() > 0 && isNew(vector.constData())) {
+			add(category, vectorHeaderBytes + qint64(vector.capacity()) * sizeof(T));
+		}
+	}
+	//@}
+
+private:
+	static const int vectorHeaderBytes = 24;
+
+	bool isNew(const void* data);
+
+	qint64 bytes_[CategoriesCount];
+	qint64 objects_[CategoriesCount];
+	QSet<const void*> seen;
+	QSet<qint64> seenImages;
+};
+
+} // namespace ipp3
+
+#endif // IPP3_MEMORYREPORT_HPP
@@ -1,9 +1,10 @@
 #include "model.hpp"
+#include "journal.hpp"
+#include "trace.hpp"
 
-#include <QtCore/QDir>
-#include <QtCore/QFileInfo>
-#include <QtCore/QDebug>
-#include <QtWidgets/QMessageBox>
+#include <QtCore/QDataStream>
+
+#include <algorithm>
 
 namespace ipp3 {
 
@@ -31,13 +32,13 @@ int Model::Task::index() const
 
 bool Model::Task::isFinished() const
 {
-	return data().isFinished;
+	return model()->isFinished[index_];
 }
 
 int Model::Task::correctAnswers() const
 {
 	int ans = 0;
-	for (Model::Gap gap : gaps()) {
+	for (Model::Gap gap : gapRange()) {
 		if (gap.isCorrect()) {
 			ans++;
 		}
@@ -48,7 +49,7 @@ int Model::Task::correctAnswers() const
 int Model::Task::wrongAnswers() const
 {
 	int ans = 0;
-	for (Model::Gap gap : gaps()) {
+	for (Model::Gap gap : gapRange()) {
 		if (gap.isWrong()) {
 			ans++;
 		}
@@ -63,7 +64,8 @@ int Model::Task::gapsCount() const
 
 int Model::Task::choicesCount() const
 {
-	return data().choiceBox.size();
+	const ChoiceBox* box = model()->choiceBox(index_);
+	return box ? box->size() : data().sortedChoices.size();
 }
 
 QVector<Model::Gap> Model::Task::gaps() const
@@ -75,15 +77,51 @@ QVector<Model::Gap> Model::Task::gaps() const
 	return gaps;
 }
 
+Model::GapRange Model::Task::gapRange() const
+{
+	const QVector<int>& gaps = data().gapIndices;
+	return GapRange(model(), gaps.begin(), gaps.end());
+}
+
 QVector<Model::Phrase> Model::Task::choices() const
 {
 	QVector<Phrase> phrases;
-	for (int i : data().choiceBox) {
-		phrases.push_back(Phrase {model(), i});
+	phrases.reserve(choicesCount());
+	for (Phrase phrase : choiceRange()) {
+		phrases.push_back(phrase);
 	}
 	return phrases;
 }
 
+Model::ChoiceRange Model::Task::choiceRange() const
+{
+	const ChoiceBox* box = model()->choiceBox(index_);
+	if (box)
+		return ChoiceRange(model(), box->begin(), box->end());
+
+	const QVector<int>& sorted = data().sortedChoices;
+	return ChoiceRange(model(), sorted.begin(), sorted.end());
+}
+
+QVector<Model::Phrase> Model::Task::choicesWithPrefix(const QString& prefix) const
+{
+	const QString key = prefix.toLower();
+	const QVector<int>& index = data().prefixIndex;
+	const QVector<PhraseData>& phrases = model()->phrases_;
+
+	auto it = std::lower_bound(index.begin(), index.end(), key, [&] (int i, const QString& k) {
+		return phrases[i].joinedLower < k;
+	});
+
+	QVector<Phrase> result;
+	for (; it != index.end() && phrases[*it].joinedLower.startsWith(key); ++it) {
+		if (model()->phraseGap[*it] == -1) {
+			result.push_back(Phrase {model(), *it});
+		}
+	}
+	return result;
+}
+
 QVector<Either<QString, Model::Gap>> Model::Task::text() const
 {
 	QVector<Either<QString, Model::Gap>> text;
@@ -97,6 +135,12 @@ QVector<Either<QString, Model::Gap>> Model::Task::text() const
 	return text;
 }
 
+Model::TextRange Model::Task::textRange() const
+{
+	const QVector<Either<QString, int>>& text = data().text;
+	return TextRange(model(), text.begin(), text.end());
+}
+
 Model::Task::Task(const Model* model, int index) :
 	model_(model), index_(index)
 {
@@ -129,20 +173,32 @@ Model::Task Model::Phrase::task() const
 	return Task {model(), data().taskIndex};
 }
 
+int Model::Phrase::index() const
+{
+	return index_;
+}
+
 bool Model::Phrase::isInGap() const
 {
-	return data().gapIndex != -1;
+	return model()->phraseGap[index_] != -1;
 }
 
 bool Model::Phrase::isInChoices() const
 {
-	return data().gapIndex == -1;
+	return model()->phraseGap[index_] == -1;
+}
+
+int Model::Phrase::choiceIndex() const
+{
+	Q_ASSERT(isInChoices());
+	const ChoiceBox* box = model()->choiceBox(data().taskIndex);
+	return box ? box->indexOf(index_) : data().sortedPosition;
 }
 
 Model::Gap Model::Phrase::gap() const
 {
 	Q_ASSERT(isInGap());
-	return Gap {model(), data().gapIndex};
+	return Gap {model(), model()->phraseGap[index_]};
 }
 
 QStringList Model::Phrase::words() const
@@ -182,9 +238,14 @@ Model::Task Model::Gap::task() const
 	return Task {model(), data().taskIndex};
 }
 
+int Model::Gap::index() const
+{
+	return index_;
+}
+
 bool Model::Gap::isEmpty() const
 {
-	return data().phrase == -1;
+	return model()->gapPhrase[index_] == -1;
 }
 
 bool Model::Gap::isCorrect() const
@@ -208,7 +269,7 @@ bool Model::Gap::hasImage() const
 Model::Phrase Model::Gap::phrase() const
 {
 	Q_ASSERT(!isEmpty());
-	return Phrase {model(), data().phrase};
+	return Phrase {model(), model()->gapPhrase[index_]};
 }
 
 const QImage& Model::Gap::image() const
@@ -232,101 +293,76 @@ const Model::GapData& Model::Gap::data() const
 	return model()->gaps_[index_];
 }
 
-// Model
+// TextElement
 
-Model::Model(const ipp3::ltf::Document& doc, const QDir& imageDir) :
-	currentTask_(0)
+Model::TextElement::TextElement(const Model* model, const Either<QString, int>& element) :
+	model_(model), element_(&element)
 {
-	for (const ltf::Task& task : doc.tasks) {
-		int taskIndex = pushTask();
-
-		for (const Either<QString, ltf::Gap>& elem : task.content) {
-			if (elem.isLeft()) {
-				pushText(taskIndex, elem.left());
-			} else {
-				pushGap(taskIndex, elem.right(), imageDir);
-			}
-		}
-
-		for (const QString& phrase : task.extra) {
-			pushPhrase(taskIndex, phrase);
-		}
-	}
-
-	// Sort phrases lexicographically.
-	for (int i = 0; i < tasks_.size(); ++i) {
-		sortChoices(i);
-	}
 }
 
-void Model::sortChoices(int taskIndex)
+bool Model::TextElement::isLeft() const
 {
-	TaskData& td = tasks_[taskIndex];
-	qSort(td.choiceBox.begin(), td.choiceBox.end(), [=] (int i, int j) {
-		int cmp = phrases_[i].joinedLower.compare(phrases_[j].joinedLower);
-		if (cmp != 0)
-			return cmp < 0;
-		return i < j;
-	});
+	return element_->isLeft();
 }
 
-int Model::pushTask()
+bool Model::TextElement::isRight() const
 {
-	TaskData td;
-	td.isFinished = false;
-	tasks_.push_back(td);
+	return element_->isRight();
+}
 
-	return tasks_.size() - 1;
+const QString& Model::TextElement::left() const
+{
+	return element_->left();
 }
 
-void Model::pushText(int taskIndex, const QString& text)
+Model::Gap Model::TextElement::right() const
 {
-	for (const QString& word : toWords(text)) {
-		tasks_[taskIndex].text.push_back(word);
-	}
+	return model_->gap(element_->right());
 }
 
-void Model::pushPhrase(int taskIndex, const QString& phrase)
+// Model
+
+Model::Model(const ipp3::ltf::Document& doc, const QDir& imageDir) :
+	Model(QSharedPointer<const Bank>(new Bank(doc, imageDir)))
 {
-	pushPhrase(taskIndex, toWords(phrase));
 }
 
-void Model::pushPhrase(int taskIndex, const QStringList& words)
+Model::Model(QSharedPointer<const Bank> bank) :
+	bank_(bank),
+	tasks_(bank->tasks()),
+	phrases_(bank->phrases()),
+	gaps_(bank->gaps()),
+	gapPhrase(gaps_.size(), -1),
+	phraseGap(phrases_.size(), -1),
+	isFinished(tasks_.size(), false),
+	currentTask_(0),
+	journal_(nullptr),
+	finishedTasks_(0),
+	correctAnswers_(0),
+	wrongAnswers_(0)
 {
-	int phraseIndex = phrases_.size();
-	tasks_[taskIndex].choiceBox.push_back(phraseIndex);
-	
-	PhraseData pd;
-	pd.gapIndex = -1;
-	pd.words = words;
-	pd.joinedLower = words.join(' ').toLower();
-	pd.taskIndex = taskIndex;
-	phrases_.push_back(pd);
+	IPP3_TRACE("Model", "load");
 }
 
-void Model::pushGap(int taskIndex, const ltf::Gap& gap, const QDir& imageDir)
+QSharedPointer<const Bank> Model::bank() const
 {
-	QStringList words = toWords(gap.content);
-	pushPhrase(taskIndex, words);
+	return bank_;
+}
 
-	GapData gd;
-	gd.phrase = -1;
-	gd.answer = words;
-	gd.taskIndex = taskIndex;
+const ChoiceBox* Model::choiceBox(int taskIndex) const
+{
+	auto it = choiceBoxes.find(taskIndex);
+	return it == choiceBoxes.end() ? nullptr : &it.value();
+}
 
-	if (!gap.img.isEmpty()) {
-		QFileInfo pathInfo(imageDir, gap.img);
-		if (!gd.image.load(pathInfo.absoluteFilePath())) {
-			// TODO: showing a message box here isn't pretty
-			QMessageBox::warning(nullptr, QObject::tr("Warning"),
-				QObject::tr("Cannot load image \"%1\".").arg(pathInfo.absoluteFilePath()));
-		}
+ChoiceBox& Model::mutableChoiceBox(int taskIndex)
+{
+	auto it = choiceBoxes.find(taskIndex);
+	if (it == choiceBoxes.end()) {
+		it = choiceBoxes.insert(taskIndex, ChoiceBox());
+		it.value().assign(tasks_[taskIndex].sortedChoices);
 	}
-
-	int gapIndex = gaps_.size();
-	gaps_.push_back(gd);
-	tasks_[taskIndex].gapIndices.push_back(gapIndex);
-	tasks_[taskIndex].text.push_back(gapIndex);
+	return it.value();
 }
 
 QVector<Model::Task> Model::tasks() const
@@ -338,10 +374,47 @@ QVector<Model::Task> Model::tasks() const
 	return tasks;
 }
 
+Model::TaskRange Model::taskRange() const
+{
+	return TaskRange(this, 0, tasks_.size());
+}
+
+Model::Task Model::task(int index) const
+{
+	Q_ASSERT(index >= 0 && index < tasks_.size());
+	return Task {this, index};
+}
+
+Model::Phrase Model::phrase(int index) const
+{
+	Q_ASSERT(index >= 0 && index < phrases_.size());
+	return Phrase {this, index};
+}
+
+Model::Gap Model::gap(int index) const
+{
+	Q_ASSERT(index >= 0 && index < gaps_.size());
+	return Gap {this, index};
+}
+
+int Model::tasksCount() const
+{
+	return tasks_.size();
+}
+
+int Model::phrasesCount() const
+{
+	return phrases_.size();
+}
+
 void Model::switchTask(Task task)
 {
 	Q_ASSERT(task.model() == this);
 	currentTask_ = task.index();
+
+	if (journal_) {
+		journal_->record(Journal::Op::Switch, currentTask_);
+	}
 }
 
 Model::Task Model::currentTask() const
@@ -360,24 +433,19 @@ Model::Task Model::nextTask()
 	return Task {this, currentTask_+1};
 }
 
+int Model::finishedTasks() const
+{
+	return finishedTasks_;
+}
+
 int Model::correctAnswers() const
 {
-	int ans = 0;
-	for (Task task : tasks()) {
-		if (task.isFinished())
-			ans += task.correctAnswers();
-	}
-	return ans;
+	return correctAnswers_;
 }
 
 int Model::wrongAnswers() const
 {
-	int ans = 0;
-	for (Task task : tasks()) {
-		if (task.isFinished())
-			ans += task.wrongAnswers();
-	}
-	return ans;
+	return wrongAnswers_;
 }
 
 int Model::totalGaps() const
@@ -394,15 +462,14 @@ int Model::insert(Phrase phrase, Gap gap)
 	Q_ASSERT(phrase.task() == gap.task());
 	Q_ASSERT(!phrase.task().isFinished());
 
-	TaskData& td = tasks_[phrase.task().index()];
-	PhraseData& pd = phrases_[phrase.index_];
-	GapData& gd = gaps_[gap.index_];
+	phraseGap[phrase.index_] = gap.index_;
+	gapPhrase[gap.index_] = phrase.index_;
 
-	pd.gapIndex = gap.index_;
-	gd.phrase = phrase.index_;
+	int choiceIndex = mutableChoiceBox(phrase.task().index()).remove(phrase.index_);
 
-	int choiceIndex = td.choiceBox.indexOf(phrase.index_);
-	td.choiceBox.removeAt(choiceIndex);
+	if (journal_) {
+		journal_->record(Journal::Op::Insert, phrase.index_, gap.index_);
+	}
 
 	return choiceIndex;
 }
@@ -415,19 +482,31 @@ void Model::remove(Gap gap, uint insertBefore)
 
 	Phrase phrase = gap.phrase();
 
-	TaskData& td = tasks_[phrase.task().index()];
-	PhraseData& pd = phrases_[phrase.index_];
-	GapData& gd = gaps_[gap.index_];
+	ChoiceBox& box = mutableChoiceBox(phrase.task().index());
+	Q_ASSERT(int(insertBefore) <= box.size());
+	box.insert(insertBefore, phrase.index_);
 
-	td.choiceBox.insert(insertBefore, phrase.index_);
+	phraseGap[phrase.index_] = -1;
+	gapPhrase[gap.index_] = -1;
 
-	pd.gapIndex = -1;
-	gd.phrase = -1;
+	if (journal_) {
+		journal_->record(Journal::Op::Remove, gap.index_, insertBefore);
+	}
 }
 
 void Model::finish()
 {
-	tasks_[currentTask_].isFinished = true;
+	if (!isFinished[currentTask_]) {
+		Task task = currentTask();
+		finishedTasks_++;
+		correctAnswers_ += task.correctAnswers();
+		wrongAnswers_ += task.wrongAnswers();
+	}
+	isFinished[currentTask_] = true;
+
+	if (journal_) {
+		journal_->record(Journal::Op::Finish, currentTask_);
+	}
 }
 
 void Model::swap(Gap a, Gap b)
@@ -437,38 +516,155 @@ void Model::swap(Gap a, Gap b)
 	Q_ASSERT(a.task() == b.task());
 	Q_ASSERT(!a.task().isFinished());
 
-	int phraseA = gaps_[a.index_].phrase;
-	int phraseB = gaps_[b.index_].phrase;
+	int phraseA = gapPhrase[a.index_];
+	int phraseB = gapPhrase[b.index_];
 
 	if (phraseA != -1) {
-		phrases_[phraseA].gapIndex = b.index_;
+		phraseGap[phraseA] = b.index_;
 	}
 	if (phraseB != -1) {
-		phrases_[phraseB].gapIndex = a.index_;
+		phraseGap[phraseB] = a.index_;
 	}
 
-	std::swap(gaps_[a.index_].phrase, gaps_[b.index_].phrase);
+	std::swap(gapPhrase[a.index_], gapPhrase[b.index_]);
+
+	if (journal_) {
+		journal_->record(Journal::Op::Swap, a.index_, b.index_);
+	}
 }
 
 void Model::reset()
 {
-	tasks_[currentTask_].isFinished = false;
+	if (isFinished[currentTask_]) {
+		Task task = currentTask();
+		finishedTasks_--;
+		correctAnswers_ -= task.correctAnswers();
+		wrongAnswers_ -= task.wrongAnswers();
+	}
+	isFinished[currentTask_] = false;
 
 	// move phrases out of gaps
-	for (Gap gap : currentTask().gaps()) {
-		if (!gap.isEmpty()) {
-			remove(gap);
+	for (int gapIndex : tasks_[currentTask_].gapIndices) {
+		int& phrase = gapPhrase[gapIndex];
+		if (phrase != -1) {
+			phraseGap[phrase] = -1;
+			phrase = -1;
+		}
+	}
+
+	// all phrases are back in the choice box in the initial order
+	choiceBoxes.remove(currentTask_);
+
+	if (journal_) {
+		journal_->record(Journal::Op::Reset, currentTask_);
+	}
+}
+
+QByteArray Model::saveState() const
+{
+	QByteArray state;
+	QDataStream out(&state, QIODevice::WriteOnly);
+	out << qint32(tasks_.size()) << qint32(phrases_.size()) << qint32(gaps_.size());
+	out << qint32(currentTask_);
+
+	for (int i = 0; i < tasks_.size(); ++i) {
+		const ChoiceBox* box = choiceBox(i);
+		out << isFinished[i] << (box ? box->toVector() : tasks_[i].sortedChoices);
+	}
+	for (int phrase : gapPhrase) {
+		out << qint32(phrase);
+	}
+
+	return state;
+}
+
+bool Model::restoreState(const QByteArray& state)
+{
+	QDataStream in(state);
+	qint32 tasksCount, phrasesCount, gapsCount, currentTask;
+	in >> tasksCount >> phrasesCount >> gapsCount >> currentTask;
+	if (in.status() != QDataStream::Ok || tasksCount != tasks_.size()
+		|| phrasesCount != phrases_.size() || gapsCount != gaps_.size()
+		|| currentTask < 0 || currentTask >= tasksCount) {
+		return false;
+	}
+
+	// Read everything first, every phrase must be placed exactly once
+	// within its own task.
+	QVector<int> placed(phrases_.size(), 0);
+	QVector<bool> finished(tasks_.size());
+	QVector<QVector<int>> savedBoxes(tasks_.size());
+	for (int i = 0; i < tasks_.size(); ++i) {
+		in >> finished[i] >> savedBoxes[i];
+		for (int p : savedBoxes[i]) {
+			if (p < 0 || p >= phrases_.size() || phrases_[p].taskIndex != i || placed[p]++)
+				return false;
+		}
+	}
+
+	QVector<int> gapPhrases(gaps_.size());
+	for (int i = 0; i < gaps_.size(); ++i) {
+		qint32 p;
+		in >> p;
+		gapPhrases[i] = p;
+		if (p == -1)
+			continue;
+		if (p < 0 || p >= phrases_.size() || phrases_[p].taskIndex != gaps_[i].taskIndex || placed[p]++)
+			return false;
+	}
+
+	if (in.status() != QDataStream::Ok || placed.contains(0))
+		return false;
+
+	// Apply.
+	currentTask_ = currentTask;
+	isFinished = finished;
+	choiceBoxes.clear();
+	for (int i = 0; i < tasks_.size(); ++i) {
+		if (savedBoxes[i] != tasks_[i].sortedChoices) {
+			choiceBoxes[i].assign(savedBoxes[i]);
+		}
+	}
+	gapPhrase = gapPhrases;
+	phraseGap.fill(-1);
+	for (int i = 0; i < gaps_.size(); ++i) {
+		if (gapPhrases[i] != -1) {
+			phraseGap[gapPhrases[i]] = i;
+		}
+	}
+
+	finishedTasks_ = 0;
+	correctAnswers_ = 0;
+	wrongAnswers_ = 0;
+	for (Task task : taskRange()) {
+		if (task.isFinished()) {
+			finishedTasks_++;
+			correctAnswers_ += task.correctAnswers();
+			wrongAnswers_ += task.wrongAnswers();
 		}
 	}
 
-	// sort the choices
-	sortChoices(currentTask_);
+	return true;
+}
+
+MemoryReport Model::memoryReport() const
+{
+	MemoryReport report;
+	bank_->memoryReport(&report);
+
+	report.addVector(MemoryReport::SessionState, gapPhrase);
+	report.addVector(MemoryReport::SessionState, phraseGap);
+	report.addVector(MemoryReport::SessionState, isFinished);
+	for (const ChoiceBox& box : choiceBoxes) {
+		report.add(MemoryReport::SessionState, box.memoryUsage());
+	}
+
+	return report;
 }
 
-QStringList Model::toWords(const QString& str) const
+void Model::setJournal(Journal* journal)
 {
-	static QRegExp regexp("\\s+");
-	return str.trimmed().split(regexp);
+	journal_ = journal;
 }
 
 } // namespace ipp3
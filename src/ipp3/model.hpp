@@ -4,24 +4,89 @@
 #include <QtCore/QStringList>
 #include <QtCore/QString>
 #include <QtCore/QVector>
+#include <QtCore/QHash>
 #include <QtCore/QDir>
+#include <QtCore/QSharedPointer>
 #include <QtGui/QImage>
 
 #include "either.hpp"
+#include "bank.hpp"
+#include "choicebox.hpp"
+#include "handlerange.hpp"
 #include "ltf/document.hpp"
 
 namespace ipp3 {
 
+class Journal;
+
+/**
+ * Answers given in one session over a bank.
+ *
+ * @details
+ * The content is read from a shared, immutable Bank. The model itself
+ * only holds a few arrays indexed by gap, phrase and task, plus choice
+ * boxes for the tasks whose choice order differs from the initial one,
+ * so creating another session over the same bank is cheap.
+ */
 class Model
 {
 private:
-	struct TaskData;
-	struct PhraseData;
-	struct GapData;
+	typedef Bank::TaskData TaskData;
+	typedef Bank::PhraseData PhraseData;
+	typedef Bank::GapData GapData;
 
 public:
+	class Task;
 	class Gap;
 	class Phrase;
+	class TextElement;
+
+	/**
+	 * Walks a choice box, or the initial order of a task that has none.
+	 */
+	class ChoiceIterator
+	{
+	public:
+		ChoiceIterator(QVector<int>::const_iterator it) : sorted(it), isBoxed(false) {}
+		ChoiceIterator(ChoiceBox::const_iterator it) : boxed(it), isBoxed(true) {}
+
+		int operator*() const {
+			return isBoxed ? *boxed : *sorted;
+		}
+
+		ChoiceIterator& operator++() {
+			if (isBoxed) {
+				++boxed;
+			} else {
+				++sorted;
+			}
+			return *this;
+		}
+
+		bool operator==(const ChoiceIterator& it) const {
+			return isBoxed ? boxed == it.boxed : sorted == it.sorted;
+		}
+
+		bool operator!=(const ChoiceIterator& it) const {
+			return !(*this == it);
+		}
+
+	private:
+		QVector<int>::const_iterator sorted;
+		ChoiceBox::const_iterator boxed;
+		bool isBoxed;
+	};
+
+	/**
+	 * Views yielding handles on the fly, see HandleRange. Prefer them to
+	 * the QVector returning functions for read-only traversals.
+	 */
+	//@{
+	typedef HandleRange<Task, IndexIterator, Model> TaskRange;
+	typedef HandleRange<Gap, QVector<int>::const_iterator, Model> GapRange;
+	typedef HandleRange<Phrase, ChoiceIterator, Model> ChoiceRange;
+	typedef HandleRange<TextElement, QVector<Either<QString, int>>::const_iterator, Model> TextRange;
+	//@}
 
 	class Task
 	{
@@ -53,17 +118,27 @@ public:
 		 * All gaps in the task.
 		 */
 		QVector<Gap> gaps() const;
+		GapRange gapRange() const;
 
 		/**
 		 * Choices currently available.
 		 * @note order is already random.
 		 */
 		QVector<Phrase> choices() const;
+		ChoiceRange choiceRange() const;
+
+		/**
+		 * Choices currently available whose lowercase text starts with
+		 * @a prefix, ordered by that text.
+		 * @note uses a prefix index built once with the model.
+		 */
+		QVector<Phrase> choicesWithPrefix(const QString& prefix) const;
 
 		/**
 		 * Words or gaps, in the same order as they appear in the text.
 		 */
 		QVector<Either<QString, Gap>> text() const;
+		TextRange textRange() const;
 
 	private:
 		Task() = default;
@@ -74,6 +149,7 @@ public:
 		int index_;
 
 		friend Model;
+		friend TaskRange;
 	};
 
 	class Phrase
@@ -96,6 +172,11 @@ public:
 		 */
 		Task task() const;
 
+		/**
+		 * Phrase index (unique in the model) starting with 0.
+		 */
+		int index() const;
+
 		/**
 		 * A phrase can be either in the choice box or inside a gap.
 		 */
@@ -104,6 +185,12 @@ public:
 		bool isInChoices() const;
 		//@}
 
+		/**
+		 * Position of this phrase in the choice box, in O(log n).
+		 * @warning Call only when isInChoices().
+		 */
+		int choiceIndex() const;
+
 		/**
 		 * Gap this phrase is filling.
 		 * @warning Call only when isInGap().
@@ -121,6 +208,7 @@ public:
 		int index_;
 
 		friend Model;
+		friend ChoiceRange;
 	};
 
 	class Gap
@@ -143,6 +231,11 @@ public:
 		 */
 		Task task() const;
 
+		/**
+		 * Gap index (unique in the model) starting with 0.
+		 */
+		int index() const;
+
 		bool isEmpty() const;
 		bool isCorrect() const;
 		bool isWrong() const;
@@ -170,6 +263,35 @@ public:
 		int index_;
 
 		friend Model;
+		friend GapRange;
+	};
+
+	/**
+	 * A word or a gap of a task's text. Words are referred to, not copied.
+	 */
+	class TextElement
+	{
+	public:
+		bool isLeft() const;
+		bool isRight() const;
+
+		/**
+		 * The word.
+		 */
+		const QString& left() const;
+
+		/**
+		 * The gap.
+		 */
+		Gap right() const;
+
+	private:
+		TextElement(const Model* model, const Either<QString, int>& element);
+
+		const Model* model_;
+		const Either<QString, int>* element_;
+
+		friend TextRange;
 	};
 
 	/**
@@ -179,15 +301,42 @@ public:
 	 */
 	Model(const ltf::Document& doc, const QDir& imageDir);
 
+	/**
+	 * Creates a fresh session over an existing bank.
+	 */
+	Model(QSharedPointer<const Bank> bank);
+
+	QSharedPointer<const Bank> bank() const;
+
 	QVector<Task> tasks() const;
+	TaskRange taskRange() const;
+
+	/**
+	 * Handles by index.
+	 */
+	//@{
+	Task task(int index) const;
+	Phrase phrase(int index) const;
+	Gap gap(int index) const;
+	int tasksCount() const;
+	int phrasesCount() const;
+	//@}
+
 	void switchTask(Task task);
 	Task currentTask() const;
 
 	bool hasNextTask();
 	Task nextTask();
 
+	/**
+	 * Totals over the finished tasks, kept up to date by finish(), reset()
+	 * and restoreState().
+	 */
+	//@{
+	int finishedTasks() const;
 	int correctAnswers() const;
 	int wrongAnswers() const;
+	//@}
 	int totalGaps() const;
 
 	/**
@@ -217,43 +366,52 @@ public:
 	 */
 	void reset();
 
-private:
-	QStringList toWords(const QString& str) const;
-	int pushTask();
-	void sortChoices(int taskIndex);
-	void pushText(int taskIndex, const QString& text);
-	void pushPhrase(int taskIndex, const QString& phrase);
-	void pushPhrase(int taskIndex, const QStringList& words);
-	void pushGap(int taskIndex, const ipp3::ltf::Gap& gap, const QDir& imageDir);
-
-	struct TaskData {
-		bool isFinished;
-		QVector<int> gapIndices;
-		QVector<int> choiceBox;
-		QVector<Either<QString, int>> text;
-	};
+	/**
+	 * Serializes the answer state (current task, finished tasks, gap
+	 * contents and choice box order) into a compact blob.
+	 */
+	QByteArray saveState() const;
 
-	struct PhraseData {
-		// -1 encodes that the phrase is the choice box.
-		int gapIndex;
-		QStringList words;
-		QString joinedLower;
-		int taskIndex;
-	};
+	/**
+	 * Restores a state produced by saveState() on a model built from the
+	 * same document. Returns false and leaves the model untouched if the
+	 * state does not fit the model.
+	 */
+	bool restoreState(const QByteArray& state);
 
-	struct GapData {
-		// -1 encodes that the gap is empty.
-		int phrase;
-		// A null image encodes that the gap has no image.
-		QImage image;
-		QStringList answer;
-		int taskIndex;
-	};
+	/**
+	 * Records all further changes to @a journal, pass null to stop.
+	 */
+	void setJournal(Journal* journal);
+
+	/**
+	 * Memory used by the bank and by this session.
+	 */
+	MemoryReport memoryReport() const;
+
+private:
+	const ChoiceBox* choiceBox(int taskIndex) const;
+	ChoiceBox& mutableChoiceBox(int taskIndex);
+
+	QSharedPointer<const Bank> bank_;
+	const QVector<TaskData>& tasks_;
+	const QVector<PhraseData>& phrases_;
+	const QVector<GapData>& gaps_;
+
+	// -1 encodes that the gap is empty.
+	QVector<int> gapPhrase;
+	// -1 encodes that the phrase is in the choice box.
+	QVector<int> phraseGap;
+	QVector<bool> isFinished;
+	// Tasks missing here have their choices in the initial sorted order.
+	QHash<int, ChoiceBox> choiceBoxes;
 
-	QVector<TaskData> tasks_;
-	QVector<PhraseData> phrases_;
-	QVector<GapData> gaps_;
 	int currentTask_;
+	Journal* journal_;
+
+	int finishedTasks_;
+	int correctAnswers_;
+	int wrongAnswers_;
 
 	friend Task;
 	friend Phrase;
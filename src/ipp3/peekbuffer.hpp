@@ -1,56 +1,154 @@
 #ifndef IPP3_PEEKBUFFER_HPP
 #define IPP3_PEEKBUFFER_HPP
 
-#include <functional>
+#include <QtCore/QtGlobal>
+
+#include <utility>
 
 namespace ipp3 {
 
-template <typename Element>
-class PeekBuffer
+/**
+ * A FIFO queue of at most Capacity elements, stored inline.
+ */
+template <typename Element, int Capacity>
+class RingBuffer
 {
+	static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two.");
+
 public:
-	typedef std::function<bool (Element*)> Source;
+	RingBuffer() : head(0), count(0) {}
 
-	PeekBuffer() : isStored(false) {}
-	PeekBuffer(const Source& src) : isStored(false), receive(src) {}
+	int size() const {
+		return count;
+	}
 
-	bool get(Element* element) {
-		if (isStored) {
-			*element = buffer;
-			isStored = false;
-			return true;
-		}
+	bool isEmpty() const {
+		return count == 0;
+	}
+
+	bool isFull() const {
+		return count == Capacity;
+	}
+
+	/**
+	 * The @a i-th element from the front.
+	 */
+	const Element& at(int i) const {
+		Q_ASSERT(i < count);
+		return items[(head + i) & (Capacity - 1)];
+	}
+
+	void enqueue(const Element& element) {
+		slot() = element;
+		commit();
+	}
+
+	/**
+	 * The free slot behind the last element, filled in place and then
+	 * added with commit().
+	 */
+	//@{
+	Element& slot() {
+		Q_ASSERT(!isFull());
+		return items[(head + count) & (Capacity - 1)];
+	}
+
+	void commit() {
+		Q_ASSERT(!isFull());
+		++count;
+	}
+	//@}
+
+	Element dequeue() {
+		Q_ASSERT(!isEmpty());
+		Element element = std::move(items[head]);
+		head = (head + 1) & (Capacity - 1);
+		--count;
+		return element;
+	}
 
-		return receive(element);
+	void clear() {
+		head = 0;
+		count = 0;
+	}
+
+private:
+	Element items[Capacity];
+	int head;
+	int count;
+};
+
+/**
+ * Reads elements from a source with up to Capacity elements of lookahead.
+ *
+ * @details
+ * The source is any callable with the signature bool(Element*), returning
+ * false when there are no more elements. It is a template parameter, so
+ * calls to it can be inlined.
+ */
+template <typename Element, typename Source, int Capacity = 4>
+class PeekBuffer
+{
+public:
+	PeekBuffer() {}
+	PeekBuffer(const Source& src) : receive(src) {}
+
+	bool get(Element* element) {
+		if (!fill(1))
+			return false;
+		*element = buffer.dequeue();
+		return true;
 	}
 
 	bool peek(Element* element) {
-		if (isStored || receive(&buffer)) {
-			*element = buffer;
-			isStored = true;
-			return true;
-		} else {
+		return peek(0, element);
+	}
+
+	/**
+	 * Looks at the @a n-th next element (0 is the one get() returns).
+	 */
+	bool peek(int n, Element* element) {
+		Q_ASSERT(n < Capacity);
+		if (!fill(n + 1))
 			return false;
-		}
+		*element = buffer.at(n);
+		return true;
+	}
+
+	/**
+	 * The @a n-th next element in place, or null if there is none. Valid
+	 * until that element is consumed.
+	 */
+	const Element* peekAt(int n) {
+		Q_ASSERT(n < Capacity);
+		if (!fill(n + 1))
+			return nullptr;
+		return &buffer.at(n);
 	}
 
 	void skip() {
-		if (isStored) {
-			isStored = false;
-		} else {
-			receive(&buffer);
+		if (fill(1)) {
+			buffer.dequeue();
 		}
 	}
 
 	void reset(const Source& src) {
-		isStored = false;
+		buffer.clear();
 		receive = src;
 	}
 
 private:
-	bool isStored;
-	Element buffer;
+	bool fill(int count) {
+		while (buffer.size() < count) {
+			if (!receive(&buffer.slot()))
+				return false;
+			buffer.commit();
+		}
+		return true;
+	}
+
 	Source receive;
+	RingBuffer<Element, Capacity> buffer;
 };
 
 } // namespace ipp3
@@ -0,0 +1,163 @@
+#include "searchindex.hpp"
+#include "trace.hpp"
+
+#include <QtCore/QStringList>
+
+#include <algorithm>
+#include <iterator>
+#include <queue>
+
+namespace ipp3 {
+
+SearchIndex::SearchIndex(const Bank& bank)
+{
+	IPP3_TRACE("SearchIndex", "load");
+
+	// Tasks are visited in order, so every list comes out sorted.
+	QHash<QString, QVector<int>> lists;
+	for (int i = 0; i < bank.tasks().size(); ++i) {
+		const Bank::TaskData& td = bank.tasks()[i];
+		for (const Either<QString, int>& elem : td.text) {
+			if (elem.isLeft()) {
+				addTerm(&lists, elem.left(), i);
+			}
+		}
+		for (int phrase : td.sortedChoices) {
+			for (const QString& word : bank.phrases()[phrase].words) {
+				addTerm(&lists, word, i);
+			}
+		}
+	}
+
+	terms.reserve(lists.size());
+	for (auto it = lists.constBegin(); it != lists.constEnd(); ++it) {
+		terms.append(it.key());
+	}
+	std::sort(terms.begin(), terms.end());
+
+	postingsStart.reserve(terms.size() + 1);
+	for (const QString& term : terms) {
+		postingsStart.append(postingsData.size());
+		postingsData += lists.value(term);
+	}
+	postingsStart.append(postingsData.size());
+}
+
+QVector<int> SearchIndex::exact(const QString& word) const
+{
+	QString term = normalize(word);
+	auto it = std::lower_bound(terms.begin(), terms.end(), term);
+	if (term.isEmpty() || it == terms.end() || *it != term)
+		return {};
+
+	int i = it - terms.begin();
+	return postings(i, i + 1);
+}
+
+QVector<int> SearchIndex::prefix(const QString& prefix) const
+{
+	QString term = normalize(prefix);
+	if (term.isEmpty())
+		return {};
+
+	// Terms with the prefix form a contiguous range of the sorted terms.
+	auto from = std::lower_bound(terms.begin(), terms.end(), term);
+	auto to = std::partition_point(from, terms.end(),
+								   [&term] (const QString& t) { return t.startsWith(term); });
+	return postings(from - terms.begin(), to - terms.begin());
+}
+
+QVector<int> SearchIndex::search(const QString& query) const
+{
+	// Split by hand, a shared QRegExp would not be safe to use from
+	// several threads.
+	QStringList words;
+	QString word;
+	for (QChar c : query) {
+		if (!c.isSpace()) {
+			word.append(c);
+		} else if (!word.isEmpty()) {
+			words.append(word);
+			word.clear();
+		}
+	}
+	if (!word.isEmpty()) {
+		words.append(word);
+	}
+	if (words.isEmpty())
+		return {};
+
+	QVector<int> result = prefix(words.takeLast());
+	for (const QString& word : words) {
+		QVector<int> tasks = exact(word);
+		QVector<int> both;
+		std::set_intersection(result.begin(), result.end(), tasks.begin(), tasks.end(),
+							  std::back_inserter(both));
+		result = both;
+	}
+	return result;
+}
+
+QString SearchIndex::normalize(const QString& word)
+{
+	int from = 0;
+	int to = word.size();
+	while (from < to && !word[from].isLetterOrNumber()) {
+		++from;
+	}
+	while (to > from && !word[to - 1].isLetterOrNumber()) {
+		--to;
+	}
+	return word.mid(from, to - from).toLower();
+}
+
+void SearchIndex::addTerm(QHash<QString, QVector<int>>* lists, const QString& word, int taskIndex)
+{
+	QString term = normalize(word);
+	if (term.isEmpty())
+		return;
+
+	QVector<int>& tasks = (*lists)[term];
+	if (tasks.isEmpty() || tasks.last() != taskIndex) {
+		tasks.append(taskIndex);
+	}
+}
+
+QVector<int> SearchIndex::postings(int from, int to) const
+{
+	if (from == to)
+		return {};
+
+	const int* data = postingsData.constData();
+	if (to - from == 1)
+		return postingsData.mid(postingsStart[from], postingsStart[to] - postingsStart[from]);
+
+	// The lists are sorted, so they are merged by always taking the
+	// smallest head, dropping tasks shared by several terms.
+	struct Cursor {
+		const int* next;
+		const int* end;
+		bool operator<(const Cursor& other) const {
+			return *next > *other.next;
+		}
+	};
+	std::priority_queue<Cursor> heads;
+	for (int i = from; i < to; ++i) {
+		heads.push(Cursor {data + postingsStart[i], data + postingsStart[i + 1]});
+	}
+
+	QVector<int> tasks;
+	while (!heads.empty()) {
+		Cursor head = heads.top();
+		heads.pop();
+		if (tasks.isEmpty() || tasks.last() != *head.next) {
+			tasks.append(*head.next);
+		}
+		if (++head.next != head.end) {
+			heads.push(head);
+		}
+	}
+	return tasks;
+}
+
+} // namespace ipp3
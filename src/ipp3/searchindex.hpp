@@ -0,0 +1,63 @@
+#ifndef IPP3_SEARCHINDEX_HPP
+#define IPP3_SEARCHINDEX_HPP
+
+#include <QtCore/QString>
+#include <QtCore/QHash>
+#include <QtCore/QVector>
+
+#include "bank.hpp"
+
+namespace ipp3 {
+
+/**
+ * Inverted index of the words of a bank, for finding tasks.
+ *
+ * @details
+ * Words are taken from the text of the tasks and from their phrases (gap
+ * answers and extras), lowercased and stripped of punctuation around
+ * them. The terms are kept sorted, each with the sorted list of tasks it
+ * appears in, so a word or a prefix is looked up by binary search and
+ * only the matching task lists are touched. The lists of the terms of a
+ * prefix are merged, not concatenated and sorted again. The index is immutable once
+ * built, so it can be queried from any thread.
+ */
+class SearchIndex
+{
+public:
+	SearchIndex(const Bank& bank);
+
+	/**
+	 * Tasks containing the word @a word.
+	 */
+	QVector<int> exact(const QString& word) const;
+
+	/**
+	 * Tasks containing a word starting with @a prefix.
+	 */
+	QVector<int> prefix(const QString& prefix) const;
+
+	/**
+	 * Tasks containing all the words of @a query. The last word is matched
+	 * as a prefix, since it may still be being typed. An empty query
+	 * matches nothing.
+	 */
+	QVector<int> search(const QString& query) const;
+
+	/**
+	 * The form words are indexed and looked up in.
+	 */
+	static QString normalize(const QString& word);
+
+private:
+	static void addTerm(QHash<QString, QVector<int>>* lists, const QString& word, int taskIndex);
+	QVector<int> postings(int from, int to) const;
+
+	QVector<QString> terms;
+	// Tasks of terms[i] are postingsData[postingsStart[i]..postingsStart[i + 1]).
+	QVector<int> postingsStart;
+	QVector<int> postingsData;
+};
+
+} // namespace ipp3
+
+#endif // IPP3_SEARCHINDEX_HPP
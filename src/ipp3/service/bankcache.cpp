@@ -0,0 +1,69 @@
+#include "bankcache.hpp"
+
+#include <QtCore/QFileInfo>
+#include <QtCore/QObject>
+
+namespace ipp3 {
+namespace service {
+
+QSharedPointer<Grader> BankCache::grader(const QString& fileName, QString* error)
+{
+	QFileInfo info(fileName);
+	QString key = info.canonicalFilePath();
+	if (key.isEmpty()) {
+		*error = QObject::tr("No such file %1.").arg(fileName);
+		return {};
+	}
+
+	QDateTime modified = info.lastModified();
+	qint64 size = info.size();
+
+	QMutexLocker lock(&mutex);
+	auto it = entries.find(key);
+	if (it != entries.end() && it->modified == modified && it->size == size) {
+		QSharedPointer<Load> load = it->load;
+		while (!load->done) {
+			loaded.wait(&mutex);
+		}
+		if (!load->grader) {
+			*error = load->error;
+		}
+		return load->grader;
+	}
+
+	// Loaded without holding the lock, requests for other banks go on.
+	QSharedPointer<Load> load(new Load {false, {}, QString()});
+	entries.insert(key, Entry {modified, size, load});
+	lock.unlock();
+
+	QString loadError;
+	QSharedPointer<Grader> grader;
+	QSharedPointer<const Bank> bank = Bank::load(key, Bank::Images::Skip, &loadError);
+	if (bank) {
+		grader = QSharedPointer<Grader>(new Grader(bank));
+	}
+
+	lock.relock();
+	load->done = true;
+	load->grader = grader;
+	load->error = loadError;
+	if (!grader) {
+		// The next request tries again.
+		it = entries.find(key);
+		if (it != entries.end() && it->load == load) {
+			entries.erase(it);
+		}
+		*error = loadError;
+	}
+	loaded.wakeAll();
+	return grader;
+}
+
+int BankCache::size() const
+{
+	QMutexLocker lock(&mutex);
+	return entries.size();
+}
+
+} // namespace service
+} // namespace ipp3
@@ -0,0 +1,60 @@
+#ifndef IPP3_SERVICE_BANKCACHE_HPP
+#define IPP3_SERVICE_BANKCACHE_HPP
+
+#include <QtCore/QDateTime>
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QString>
+#include <QtCore/QWaitCondition>
+
+#include "../grader.hpp"
+
+namespace ipp3 {
+namespace service {
+
+/**
+ * Parsed banks (wrapped in graders) kept in memory, keyed by the canonical
+ * path of the file. An entry is reloaded when the file's modification time
+ * or size changes. Thread safe.
+ *
+ * @details
+ * A bank is loaded by the first request that needs it, without holding
+ * the lock. Requests for the same bank arriving meanwhile wait for that
+ * load, so a burst of requests parses the file once and all of them
+ * grade against (and add to the statistics of) the same grader.
+ */
+class BankCache
+{
+public:
+	/**
+	 * The grader for a LTF file, loading it if needed.
+	 * Returns null and sets @a error if the file cannot be loaded.
+	 */
+	QSharedPointer<Grader> grader(const QString& fileName, QString* error);
+
+	int size() const;
+
+private:
+	// A load in progress or done. Guarded by the mutex.
+	struct Load {
+		bool done;
+		QSharedPointer<Grader> grader;
+		QString error;
+	};
+
+	struct Entry {
+		QDateTime modified;
+		qint64 size;
+		QSharedPointer<Load> load;
+	};
+
+	mutable QMutex mutex;
+	QWaitCondition loaded;
+	QHash<QString, Entry> entries;
+};
+
+} // namespace service
+} // namespace ipp3
+
+#endif // IPP3_SERVICE_BANKCACHE_HPP
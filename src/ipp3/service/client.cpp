@@ -0,0 +1,54 @@
+#include "client.hpp"
+
+#include <QtCore/QFile>
+#include <QtCore/QTextStream>
+#include <QtNetwork/QLocalSocket>
+
+namespace ipp3 {
+namespace service {
+
+static const int timeoutMs = 30000;
+
+int runClient(const QString& name)
+{
+	QTextStream err(stderr);
+
+	QLocalSocket socket;
+	socket.connectToServer(name);
+	if (!socket.waitForConnected(timeoutMs)) {
+		err << "Cannot connect to " << name << ": " << socket.errorString() << endl;
+		return 1;
+	}
+
+	// Send everything first, the server answers requests concurrently.
+	QFile in;
+	in.open(stdin, QFile::ReadOnly);
+	int pending = 0;
+	while (!in.atEnd()) {
+		QByteArray line = in.readLine().trimmed();
+		if (line.isEmpty())
+			continue;
+		socket.write(line + "\n");
+		pending++;
+	}
+	socket.flush();
+
+	QFile out;
+	out.open(stdout, QFile::WriteOnly);
+	while (pending > 0) {
+		if (!socket.canReadLine() && !socket.waitForReadyRead(timeoutMs)) {
+			err << "No response: " << socket.errorString() << endl;
+			return 1;
+		}
+		while (socket.canReadLine()) {
+			out.write(socket.readLine());
+			pending--;
+		}
+	}
+	out.flush();
+
+	return 0;
+}
+
+} // namespace service
+} // namespace ipp3
@@ -0,0 +1,19 @@
+#ifndef IPP3_SERVICE_CLIENT_HPP
+#define IPP3_SERVICE_CLIENT_HPP
+
+#include <QtCore/QString>
+
+namespace ipp3 {
+namespace service {
+
+/**
+ * A minimal client for testing the grading service: sends the requests
+ * read from stdin (one per line) to the server @a name and prints the
+ * responses to stdout. Returns the process exit code.
+ */
+int runClient(const QString& name);
+
+} // namespace service
+} // namespace ipp3
+
+#endif // IPP3_SERVICE_CLIENT_HPP
@@ -0,0 +1,292 @@
+#include "gradingserver.hpp"
+#include "../trace.hpp"
+
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QRunnable>
+#include <QtNetwork/QLocalSocket>
+
+namespace ipp3 {
+namespace service {
+
+// Submissions from one request are graded on all cores only above this.
+static const int parallelGradingThreshold = 1024;
+
+/**
+ * A request handled on the pool.
+ */
+class Request : public QRunnable
+{
+public:
+	Request(GradingServer* server, quint64 connection, const QByteArray& line, qint64 receivedAt) :
+		server(server), connection(connection), line(line), receivedAt(receivedAt)
+	{
+	}
+
+	virtual void run()
+	{
+		QByteArray response = server->handle(line, receivedAt);
+		QMetaObject::invokeMethod(server, "deliver", Qt::QueuedConnection,
+			Q_ARG(quint64, connection), Q_ARG(QByteArray, response));
+	}
+
+private:
+	GradingServer* server;
+	quint64 connection;
+	QByteArray line;
+	qint64 receivedAt;
+};
+
+GradingServer::GradingServer(QObject* parent) :
+	QObject(parent),
+	nextConnection(0),
+	requests(0),
+	errors(0),
+	submissions(0),
+	totalLatency(0),
+	maxLatency(0)
+{
+	clock.start();
+	connect(&server, &QLocalServer::newConnection, this, &GradingServer::newConnection);
+}
+
+GradingServer::~GradingServer()
+{
+	pool.waitForDone();
+}
+
+bool GradingServer::listen(const QString& name)
+{
+	// A stale socket file is left behind if the previous daemon crashed.
+	QLocalServer::removeServer(name);
+	return server.listen(name);
+}
+
+QString GradingServer::errorString() const
+{
+	return server.errorString();
+}
+
+void GradingServer::deliver(quint64 connection, const QByteArray& response)
+{
+	QLocalSocket* socket = connections.value(connection);
+	if (socket) {
+		socket->write(response);
+		socket->write("\n");
+	}
+}
+
+void GradingServer::newConnection()
+{
+	while (QLocalSocket* socket = server.nextPendingConnection()) {
+		quint64 id = nextConnection++;
+		connections.insert(id, socket);
+
+		connect(socket, &QLocalSocket::readyRead, this, [=] () { readRequests(id); });
+		connect(socket, &QLocalSocket::disconnected, this, [=] () {
+			connections.remove(id);
+			socket->deleteLater();
+		});
+	}
+}
+
+void GradingServer::readRequests(quint64 connection)
+{
+	QLocalSocket* socket = connections.value(connection);
+	if (!socket)
+		return;
+
+	bool tooLong = false;
+	while (socket->canReadLine()) {
+		QByteArray line = socket->readLine(maxRequestSize + 1);
+		if (line.size() > maxRequestSize) {
+			tooLong = true;
+			break;
+		}
+		line = line.trimmed();
+		if (!line.isEmpty()) {
+			pool.start(new Request(this, connection, line, clock.nsecsElapsed()));
+		}
+	}
+
+	// A client that never ends its line would be buffered without bound.
+	if (tooLong || socket->bytesAvailable() > maxRequestSize) {
+		QJsonObject response;
+		response["error"] = tr("Request longer than %1 bytes.").arg(maxRequestSize);
+		deliver(connection, QJsonDocument(response).toJson(QJsonDocument::Compact));
+		connections.remove(connection);
+		socket->disconnectFromServer();
+	}
+}
+
+QByteArray GradingServer::handle(const QByteArray& line, qint64 receivedAt)
+{
+	IPP3_TRACE("GradingServer::handle", "grading");
+	QJsonParseError parseError;
+	QJsonDocument doc = QJsonDocument::fromJson(line, &parseError);
+
+	QJsonObject response;
+	if (!doc.isObject()) {
+		response["error"] = tr("Invalid JSON: %1").arg(parseError.errorString());
+	} else {
+		QJsonObject request = doc.object();
+		QString op = request.value("op").toString("grade");
+		if (op == "grade") {
+			response = grade(request);
+		} else if (op == "report") {
+			response = report(request);
+		} else if (op == "stats") {
+			response = stats();
+		} else {
+			response["error"] = tr("Unknown op \"%1\".").arg(op);
+		}
+		if (request.contains("id")) {
+			response["id"] = request.value("id");
+		}
+	}
+
+	requests++;
+	if (response.contains("error")) {
+		errors++;
+	}
+
+	qint64 latency = clock.nsecsElapsed() - receivedAt;
+	totalLatency += latency;
+	qint64 max = maxLatency;
+	while (latency > max && !maxLatency.compare_exchange_weak(max, latency)) {
+	}
+
+	return QJsonDocument(response).toJson(QJsonDocument::Compact);
+}
+
+QJsonObject GradingServer::grade(const QJsonObject& request)
+{
+	QJsonObject response;
+
+	QString error;
+	QSharedPointer<Grader> grader = cache.grader(request.value("bank").toString(), &error);
+	if (!grader) {
+		response["error"] = error;
+		return response;
+	}
+
+	// Each submission is either an array of phrase indices (one per gap)
+	// or an object mapping gap indices to phrase indices.
+	const QJsonArray list = request.value("answers").toArray();
+	const int gaps = grader->gapsCount();
+	const qint64 answersCount = qint64(list.size()) * gaps;
+	if (answersCount > maxAnswersPerRequest) {
+		response["error"] = tr("Too many answers in one request (%1, at most %2).")
+			.arg(answersCount).arg(maxAnswersPerRequest);
+		return response;
+	}
+	QVector<int> answers(int(answersCount), -1);
+
+	for (int i = 0; i < list.size(); ++i) {
+		int* answer = answers.data() + qint64(i) * gaps;
+		QJsonValue value = list[i];
+
+		if (value.isArray()) {
+			QJsonArray array = value.toArray();
+			if (array.size() > gaps) {
+				response["error"] = tr("Submission %1 has more than %2 answers.").arg(i).arg(gaps);
+				return response;
+			}
+			for (int g = 0; g < array.size(); ++g) {
+				answer[g] = array.at(g).toInt(-1);
+			}
+		} else if (value.isObject()) {
+			QJsonObject object = value.toObject();
+			for (auto it = object.constBegin(); it != object.constEnd(); ++it) {
+				bool ok;
+				int g = it.key().toInt(&ok);
+				if (!ok || g < 0 || g >= gaps) {
+					response["error"] = tr("Submission %1 has an invalid gap \"%2\".").arg(i).arg(it.key());
+					return response;
+				}
+				answer[g] = it.value().toInt(-1);
+			}
+		} else {
+			response["error"] = tr("Submission %1 is neither an array nor an object.").arg(i);
+			return response;
+		}
+	}
+
+	QVector<int> scores(list.size());
+	int threads = list.size() >= parallelGradingThreshold ? 0 : 1;
+	grader->grade(answers.constData(), list.size(), scores.data(), threads);
+	submissions += list.size();
+
+	QJsonArray scoreArray;
+	for (int score : scores) {
+		scoreArray.append(score);
+	}
+	response["gaps"] = gaps;
+	response["scores"] = scoreArray;
+	return response;
+}
+
+QJsonObject GradingServer::report(const QJsonObject& request)
+{
+	QJsonObject response;
+
+	QString error;
+	QSharedPointer<Grader> grader = cache.grader(request.value("bank").toString(), &error);
+	if (!grader) {
+		response["error"] = error;
+		return response;
+	}
+
+	Grader::Report report = grader->report();
+
+	QJsonArray tasks;
+	for (const Grader::TaskStats& ts : report.tasks) {
+		QJsonObject task;
+		task["correct"] = double(ts.correct);
+		task["wrong"] = double(ts.wrong);
+		task["empty"] = double(ts.empty);
+		task["perfect"] = double(ts.perfect);
+		tasks.append(task);
+	}
+
+	QJsonArray gaps;
+	for (const Grader::GapStats& gs : report.gaps) {
+		QJsonObject gap;
+		gap["correct"] = double(gs.correct);
+		gap["wrong"] = double(gs.wrong);
+		gap["empty"] = double(gs.empty);
+		gaps.append(gap);
+	}
+
+	QJsonArray picks;
+	for (qint64 count : report.phrasePicks) {
+		picks.append(double(count));
+	}
+
+	response["submissions"] = double(report.submissions);
+	response["tasks"] = tasks;
+	response["gaps"] = gaps;
+	response["phrasePicks"] = picks;
+	return response;
+}
+
+QJsonObject GradingServer::stats() const
+{
+	const double seconds = clock.nsecsElapsed() / 1e9;
+	const qint64 handled = requests;
+
+	QJsonObject response;
+	response["uptime"] = seconds;
+	response["requests"] = double(handled);
+	response["errors"] = double(errors);
+	response["submissions"] = double(submissions);
+	response["requestsPerSecond"] = handled / seconds;
+	response["submissionsPerSecond"] = submissions / seconds;
+	response["meanLatencyMs"] = handled ? totalLatency / 1e6 / handled : 0.0;
+	response["maxLatencyMs"] = maxLatency / 1e6;
+	response["banks"] = cache.size();
+	return response;
+}
+
+} // namespace service
+} // namespace ipp3
@@ -0,0 +1,86 @@
+#ifndef IPP3_SERVICE_GRADINGSERVER_HPP
+#define IPP3_SERVICE_GRADINGSERVER_HPP
+
+#include <QtCore/QObject>
+#include <QtCore/QHash>
+#include <QtCore/QThreadPool>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QJsonObject>
+#include <QtNetwork/QLocalServer>
+
+#include <atomic>
+
+#include "bankcache.hpp"
+
+class QLocalSocket;
+
+namespace ipp3 {
+namespace service {
+
+/**
+ * Grading service listening on a local socket.
+ *
+ * The protocol is described in "docs/service.txt".
+ *
+ * @details
+ * Requests are read in the main thread and handled on a thread pool, so
+ * several requests (also from one connection) are processed at once.
+ * Responses are written back from the main thread as soon as they are
+ * ready, which may be out of order; they carry the request's "id".
+ */
+class GradingServer : public QObject
+{
+	Q_OBJECT
+public:
+	// Largest number of answers (submissions times gaps) in one request.
+	static const qint64 maxAnswersPerRequest = 64 * 1024 * 1024;
+	// Longest request line, in bytes. A longer one closes the connection.
+	static const qint64 maxRequestSize = 256 * 1024 * 1024;
+
+	GradingServer(QObject* parent = nullptr);
+
+	/**
+	 * Waits for the requests in progress.
+	 */
+	~GradingServer();
+
+	bool listen(const QString& name);
+	QString errorString() const;
+
+	/**
+	 * Writes a response to a connection, if it is still open.
+	 * Called (queued) by the pool threads.
+	 */
+	Q_INVOKABLE void deliver(quint64 connection, const QByteArray& response);
+
+private:
+	friend class Request;
+
+	void newConnection();
+	void readRequests(quint64 connection);
+
+	QByteArray handle(const QByteArray& line, qint64 receivedAt);
+	QJsonObject grade(const QJsonObject& request);
+	QJsonObject report(const QJsonObject& request);
+	QJsonObject stats() const;
+
+	QLocalServer server;
+	QHash<quint64, QLocalSocket*> connections;
+	quint64 nextConnection;
+
+	QThreadPool pool;
+	BankCache cache;
+
+	// Counters, updated from the pool threads.
+	QElapsedTimer clock;
+	std::atomic<qint64> requests;
+	std::atomic<qint64> errors;
+	std::atomic<qint64> submissions;
+	std::atomic<qint64> totalLatency;
+	std::atomic<qint64> maxLatency;
+};
+
+} // namespace service
+} // namespace ipp3
+
+#endif // IPP3_SERVICE_GRADINGSERVER_HPP
@@ -0,0 +1,71 @@
+#ifndef IPP3_SPSCQUEUE_HPP
+#define IPP3_SPSCQUEUE_HPP
+
+#include <atomic>
+#include <utility>
+
+namespace ipp3 {
+
+/**
+ * A bounded lock-free queue for exactly one producer and one consumer
+ * thread.
+ *
+ * @details
+ * The producer only writes the tail and the consumer only writes the
+ * head, each published with release and read with acquire ordering, so
+ * an element is fully written before the other side can see it. Neither
+ * side ever blocks; waiting for space or for elements is up to the
+ * caller. One slot is always left free, so at most Capacity - 1 elements
+ * are queued.
+ */
+template <typename Element, int Capacity>
+class SpscQueue
+{
+	static_assert(Capacity > 1 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two.");
+
+public:
+	SpscQueue() : head(0), tail(0) {}
+
+	SpscQueue(const SpscQueue&) = delete;
+	SpscQueue& operator=(const SpscQueue&) = delete;
+
+	/**
+	 * Called by the producer. Returns false if the queue is full, in which
+	 * case @a element is left untouched.
+	 */
+	bool tryPush(Element&& element) {
+		int t = tail.load(std::memory_order_relaxed);
+		int next = (t + 1) & (Capacity - 1);
+		if (next == head.load(std::memory_order_acquire))
+			return false;
+		items[t] = std::move(element);
+		tail.store(next, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	 * Called by the consumer. Returns false if the queue is empty.
+	 */
+	bool tryPop(Element* element) {
+		int h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire))
+			return false;
+		*element = std::move(items[h]);
+		head.store((h + 1) & (Capacity - 1), std::memory_order_release);
+		return true;
+	}
+
+private:
+	// Padded apart, so the two threads do not fight over one cache line.
+	static const int cacheLine = 64;
+
+	std::atomic<int> head;
+	char headPadding[cacheLine];
+	std::atomic<int> tail;
+	char tailPadding[cacheLine];
+	Element items[Capacity];
+};
+
+} // namespace ipp3
+
+#endif // IPP3_SPSCQUEUE_HPP
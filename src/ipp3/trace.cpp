@@ -0,0 +1,117 @@
+#include "trace.hpp"
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QTextStream>
+#include <QtCore/QThread>
+#include <QtCore/QVector>
+#include <QtCore/QDebug>
+
+namespace ipp3 {
+
+namespace {
+
+struct Event {
+	const char* name;
+	const char* category;
+	qint64 start;
+	qint64 end;
+	int thread;
+	int argsCount;
+	const char* argNames[TraceSpan::maxArgs];
+	qint64 argValues[TraceSpan::maxArgs];
+};
+
+QMutex mutex;
+QElapsedTimer clock;
+QString outputFile;
+QVector<Event> events;
+// Thread ids are mapped to small numbers, which trace viewers show nicely.
+QHash<Qt::HANDLE, int> threads;
+
+} // namespace
+
+std::atomic<bool> Trace::enabled(false);
+
+void Trace::start(const QString& fileName)
+{
+	QMutexLocker lock(&mutex);
+	outputFile = fileName;
+	events.clear();
+	threads.clear();
+	clock.start();
+	enabled = true;
+}
+
+void Trace::stop()
+{
+	if (!isEnabled())
+		return;
+	enabled = false;
+
+	QMutexLocker lock(&mutex);
+	QFile file(outputFile);
+	if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
+		qWarning() << "Cannot write trace" << outputFile << file.errorString();
+		return;
+	}
+
+	// Times are in microseconds. Names are literals from the code, so they
+	// need no escaping.
+	QTextStream out(&file);
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	for (int i = 0; i < events.size(); ++i) {
+		const Event& e = events[i];
+		out << "{\"name\":\"" << e.name << "\",\"cat\":\"" << e.category
+			<< "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.thread
+			<< ",\"ts\":" << QString::number(e.start / 1000.0, 'f', 3)
+			<< ",\"dur\":" << QString::number((e.end - e.start) / 1000.0, 'f', 3);
+		if (e.argsCount > 0) {
+			out << ",\"args\":{";
+			for (int a = 0; a < e.argsCount; ++a) {
+				out << (a ? "," : "") << "\"" << e.argNames[a] << "\":" << e.argValues[a];
+			}
+			out << "}";
+		}
+		out << (i + 1 < events.size() ? "},\n" : "}\n");
+	}
+	out << "]}\n";
+
+	events.clear();
+}
+
+qint64 Trace::now()
+{
+	return clock.nsecsElapsed();
+}
+
+void Trace::record(const char* name, const char* category, qint64 start, qint64 end,
+				   int argsCount, const char* const* argNames, const qint64* argValues)
+{
+	Event e;
+	e.name = name;
+	e.category = category;
+	e.start = start;
+	e.end = end;
+	e.argsCount = qMin(argsCount, int(TraceSpan::maxArgs));
+	for (int a = 0; a < e.argsCount; ++a) {
+		e.argNames[a] = argNames[a];
+		e.argValues[a] = argValues[a];
+	}
+
+	QMutexLocker lock(&mutex);
+	if (!isEnabled())
+		return;
+
+	Qt::HANDLE id = QThread::currentThreadId();
+	auto it = threads.find(id);
+	if (it == threads.end()) {
+		it = threads.insert(id, threads.size() + 1);
+	}
+	e.thread = it.value();
+	events.push_back(e);
+}
+
+} // namespace ipp3
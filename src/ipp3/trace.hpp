@@ -0,0 +1,109 @@
+#ifndef IPP3_TRACE_HPP
+#define IPP3_TRACE_HPP
+
+#include <QtCore/QString>
+
+#include <atomic>
+
+namespace ipp3 {
+
+/**
+ * Collects timed spans and writes them in the Chrome trace event format,
+ * to be inspected in chrome://tracing or Perfetto.
+ *
+ * @details
+ * Tracing is off unless start() was called (see main.cpp: the IPP3_TRACE
+ * environment variable or the --trace option). When it is off, a span
+ * costs one relaxed atomic load.
+ */
+class Trace
+{
+public:
+	/**
+	 * Starts collecting spans, they are written to @a fileName by stop().
+	 */
+	static void start(const QString& fileName);
+
+	/**
+	 * Writes the collected spans and stops tracing.
+	 */
+	static void stop();
+
+	static bool isEnabled()
+	{
+		return enabled.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * Nanoseconds since start().
+	 */
+	static qint64 now();
+
+	/**
+	 * Records a finished span. @a name, @a category and argument names must
+	 * be string literals (they are stored as pointers).
+	 */
+	static void record(const char* name, const char* category, qint64 start, qint64 end,
+					   int argsCount = 0, const char* const* argNames = nullptr,
+					   const qint64* argValues = nullptr);
+
+private:
+	static std::atomic<bool> enabled;
+};
+
+/**
+ * A span from construction to destruction, use IPP3_TRACE.
+ */
+class TraceSpan
+{
+public:
+	static const int maxArgs = 2;
+
+	TraceSpan(const char* name, const char* category) :
+		name(name),
+		category(category),
+		start(Trace::isEnabled() ? Trace::now() : -1),
+		argsCount(0)
+	{
+	}
+
+	~TraceSpan()
+	{
+		if (start >= 0) {
+			Trace::record(name, category, start, Trace::now(), argsCount, argNames, argValues);
+		}
+	}
+
+	/**
+	 * Attaches a value shown with the span, @a arg must be a string literal.
+	 */
+	void setArg(const char* arg, qint64 value)
+	{
+		if (start >= 0 && argsCount < maxArgs) {
+			argNames[argsCount] = arg;
+			argValues[argsCount] = value;
+			argsCount++;
+		}
+	}
+
+private:
+	const char* name;
+	const char* category;
+	qint64 start;
+	int argsCount;
+	const char* argNames[maxArgs];
+	qint64 argValues[maxArgs];
+};
+
+} // namespace ipp3
+
+#define IPP3_TRACE_CONCAT_(a, b) a##b
+#define IPP3_TRACE_CONCAT(a, b) IPP3_TRACE_CONCAT_(a, b)
+
+/**
+ * Traces the enclosing scope.
+ */
+#define IPP3_TRACE(name, category) \
+	ipp3::TraceSpan IPP3_TRACE_CONCAT(traceSpan_, __LINE__)(name, category)
+
+#endif // IPP3_TRACE_HPP
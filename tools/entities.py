@@ -0,0 +1,115 @@
+#!/usr/bin/env python3
+"""Generates src/ipp3/ltf/entitytable.inc, the perfect hash table of the
+HTML5 named character references used by ltf::decodeEntity().
+
+The entities come from Python's html.entities.html5 (the WHATWG list).
+Only the names ending with ';' are used, the ';' itself is not stored.
+
+The table is a hash and displace scheme: a name hashed with seed 0
+picks a bucket, the bucket's seed hashes it again to its slot. The hash
+must match entityHash() in entities.cpp.
+
+Usage: tools/entities.py > src/ipp3/ltf/entitytable.inc
+"""
+
+import html.entities
+
+MASK = 0xFFFFFFFF
+
+
+def entity_hash(name, seed):
+    h = (2166136261 ^ seed) & MASK
+    for c in name.encode('ascii'):
+        h ^= c
+        h = (h * 16777619) & MASK
+    # Final mix (from MurmurHash3).
+    h ^= h >> 16
+    h = (h * 0x85EBCA6B) & MASK
+    h ^= h >> 13
+    h = (h * 0xC2B2AE35) & MASK
+    h ^= h >> 16
+    return h
+
+
+def utf16(text):
+    data = text.encode('utf-16-le')
+    return [data[i] | data[i + 1] << 8 for i in range(0, len(data), 2)]
+
+
+def main():
+    entities = sorted((name[:-1], value) for name, value in html.entities.html5.items()
+                      if name.endswith(';'))
+    count = len(entities)
+    bucket_count = count // 4
+    slot_count = 1
+    while slot_count < count * 3 // 2:
+        slot_count *= 2
+
+    buckets = [[] for _ in range(bucket_count)]
+    for index, (name, _) in enumerate(entities):
+        buckets[entity_hash(name, 0) % bucket_count].append(index)
+
+    seeds = [0] * bucket_count
+    slots = [None] * slot_count
+    for bucket in sorted(range(bucket_count), key=lambda b: -len(buckets[b])):
+        if not buckets[bucket]:
+            continue
+        seed = 1
+        while True:
+            taken = [entity_hash(entities[i][0], seed) & (slot_count - 1) for i in buckets[bucket]]
+            if len(set(taken)) == len(taken) and all(slots[s] is None for s in taken):
+                break
+            seed += 1
+        assert seed <= 0xFFFF
+        seeds[bucket] = seed
+        for i, s in zip(buckets[bucket], taken):
+            slots[s] = i
+
+    names = ''
+    values = []
+    records = []
+    for name, value in entities:
+        units = utf16(value)
+        records.append((len(names), len(name), len(values), len(units)))
+        names += name
+        values += units
+    assert len(names) <= 0xFFFF and len(values) <= 0xFFFF
+
+    out = []
+    out.append('// Generated by tools/entities.py, do not edit.')
+    out.append('')
+    out.append('static const int entityCount = %d;' % count)
+    out.append('static const int entityBucketCount = %d;' % bucket_count)
+    out.append('static const int entitySlotCount = %d;' % slot_count)
+    out.append('static const int maxEntityNameLength = %d;' % max(len(n) for n, _ in entities))
+    out.append('static const quint16 noEntity = 0xFFFF;')
+    out.append('')
+    out.append('static const char entityNames[] =')
+    for i in range(0, len(names), 72):
+        out.append('\t"%s"' % names[i:i + 72])
+    out.append('\t;')
+    out.append('')
+    out.append('static const quint16 entityValues[] = {')
+    for i in range(0, len(values), 10):
+        out.append('\t' + ' '.join('0x%04X,' % v for v in values[i:i + 10]))
+    out.append('};')
+    out.append('')
+    out.append('static const EntityRecord entityRecords[entityCount] = {')
+    for r in records:
+        out.append('\t{%d, %d, %d, %d},' % r)
+    out.append('};')
+    out.append('')
+    out.append('static const quint16 entitySeeds[entityBucketCount] = {')
+    for i in range(0, bucket_count, 12):
+        out.append('\t' + ' '.join('%d,' % s for s in seeds[i:i + 12]))
+    out.append('};')
+    out.append('')
+    out.append('static const quint16 entitySlots[entitySlotCount] = {')
+    for i in range(0, slot_count, 12):
+        out.append('\t' + ' '.join('%s,' % ('noEntity' if s is None else s) for s in slots[i:i + 12]))
+    out.append('};')
+    print('\n'.join(out))
+
+
+if __name__ == '__main__':
+    main()